@@ -5,10 +5,6 @@
 //
 #include      "defines.h"
 //
-// create an I2C data structure for the LCD03 display unit
-//
-I2C_STRUCT   LCD_command;
-//
 //************************************************************************
 // System functions : code.
 //************************************************************************
@@ -20,13 +16,7 @@ I2C_STRUCT   LCD_command;
 //
 void LCD03_Write_Cmd(uint8_t command)
 {
-    LCD_command.cmd[0] = LCD03_ADDRESS;
-    LCD_command.cmd[1] = REGISTER_0;
-    LCD_command.cmd[2] = command;
-    LCD_command.send_count = 3;
-    LCD_command.get_count = 0;
-    LCD_command.delay = 0;
-    exec_command(&LCD_command, WRITE_ONLY);
+    I2C_Write_Register(LCD03_ADDRESS, REGISTER_0, &command, 1);
 }
 
 //************************************************************************
@@ -41,17 +31,121 @@ void LCD03_Write_Char(char letter)
 
 //************************************************************************
 //
-// LCD03_Write_String : output a single text character to the display
+// LCD03_Free_Space : read the number of free bytes in the display buffer
+// ================
+//
+uint8_t   LCD03_Free_Space(void)
+{
+uint8_t   space;
+
+    space = 0;
+    I2C_Read_Register(LCD03_ADDRESS, REGISTER_0, &space, 1);
+    return space;
+}
+
+//************************************************************************
+//
+// LCD03_Wait_Space : wait for space in the display buffer
+// ================
+//
+// Returns number of free bytes, or 0 if none became free within
+// LCD03_BUSY_TIMEOUT mS or the display did not respond.
+//
+static uint8_t   LCD03_Wait_Space(void)
+{
+uint8_t   space;
+uint16_t  start;
+
+    start = Tick_Get();
+    do {
+        space = 0;
+        if (I2C_Read_Register(LCD03_ADDRESS, REGISTER_0, &space, 1) != I2C_OK) {
+            return 0;
+        }
+        if (space != 0) {
+            break;
+        }
+    } while (Tick_Elapsed(start) < LCD03_BUSY_TIMEOUT);
+    return space;
+}
+
+//************************************************************************
+//
+// LCD03_Write_Block : stream characters to the display
+// =================
+//
+// Description
+//    The free space in the display buffer is read, and as many characters
+//    as fit are sent as one I2C transaction to the command register.
+//    Each character then costs one byte on the bus instead of a complete
+//    start/address/register/data/stop transaction.  The characters are
+//    sent directly from 'text', or from 'text_rom' if it is not 0, with
+//    no copy.
+//
+static void   LCD03_Write_Block(const uint8_t *text, const rom uint8_t *text_rom, uint8_t length)
+{
+uint8_t     space;
+I2C_XFER    xfer;
+
+    xfer.address = LCD03_ADDRESS;
+    xfer.header[0] = REGISTER_0;
+    xfer.header_count = 1;
+    xfer.payload = text;
+    xfer.payload_rom = text_rom;
+    xfer.reply_count = 0;
+    xfer.delay = 0;
+    xfer.mode = WRITE_ONLY;
+    while (length != 0) {
+        space = LCD03_Wait_Space();
+        if (space == 0) {
+            return;
+        }
+        if (space > length) {
+            space = length;
+        }
+        xfer.payload_count = space;
+        if (I2C_Transfer(&xfer) != I2C_OK) {
+            return;
+        }
+        if (text_rom != 0) {
+            xfer.payload_rom += space;
+        } else {
+            xfer.payload += space;
+        }
+        length -= space;
+    }
+}
+
+//************************************************************************
+//
+// LCD03_Write_String : output a string to the display
 // ==================
 //
 void   LCD03_Write_String(const char text[])
 {
-char  *ch_pt;
+uint8_t     length;
 
-    ch_pt = &text[0];
-    while (*ch_pt) {
-        LCD03_Write_Char(*ch_pt++);
+    length = 0;
+    while (text[length]) {
+        length++;
     }
+    LCD03_Write_Block((const uint8_t *)text, 0, length);
+}
+
+//************************************************************************
+//
+// LCD03_Write_String_rom : output a string held in program memory
+// ======================
+//
+void   LCD03_Write_String_rom(const rom char text[])
+{
+uint8_t     length;
+
+    length = 0;
+    while (text[length]) {
+        length++;
+    }
+    LCD03_Write_Block(0, (const rom uint8_t *)text, length);
 }
 
 //************************************************************************
@@ -65,13 +159,19 @@ char  *ch_pt;
 //
 void   LCD03_Set_Cursor(uint8_t row, uint8_t column)
 {
-    LCD_command.cmd[0] = LCD03_ADDRESS;
-    LCD_command.cmd[1] = REGISTER_0;
-    LCD_command.cmd[2] = SET_ROW_COL_CURSOR;
-    LCD_command.cmd[3] = row;
-    LCD_command.cmd[4] = column;
-    LCD_command.send_count = 5;
-    LCD_command.get_count = 0;
-    LCD_command.delay = 0;
-    exec_command(&LCD_command, WRITE_ONLY);
+I2C_XFER   xfer;
+
+    xfer.address = LCD03_ADDRESS;
+    xfer.header[0] = REGISTER_0;
+    xfer.header[1] = SET_ROW_COL_CURSOR;
+    xfer.header[2] = row;
+    xfer.header[3] = column;
+    xfer.header_count = 4;
+    xfer.payload = 0;
+    xfer.payload_rom = 0;
+    xfer.payload_count = 0;
+    xfer.reply_count = 0;
+    xfer.delay = 0;
+    xfer.mode = WRITE_ONLY;
+    I2C_Transfer(&xfer);
 }
@@ -27,13 +27,19 @@
 #define     HIDE_CURSOR          4
 #define     CLEAR_SCREEN        12
 //
+// maximum time to wait for space in the display's 64 byte input buffer
+//
+#define     LCD03_BUSY_TIMEOUT  20    // mS
+//
 //************************************************************************
 // System functions : prototypes.
 //************************************************************************
 //
 void   LCD03_Write_Cmd(uint8_t command);
+uint8_t LCD03_Free_Space(void);
 void   LCD03_Write_Char(char letter);
 void   LCD03_Write_String(const char text[]);
+void   LCD03_Write_String_rom(const rom char text[]);
 void   LCD03_Set_Cursor(uint8_t row, uint8_t column);
 
 #endif //_LCD03_H
@@ -45,22 +45,27 @@ int _rows;
 int _columns;
 int _row;
 int _column; 
+static MCP23017_DEVICE  *lcd_port;      // expander that drives the display
+#ifdef I2C_TRACE
+char  lcd_screen[LCD_ROWS][LCD_COLUMNS];  // characters written to the display
+#endif
   
 //----------------------------------------------------------------------------
 // TextLCD_init : initialise display hardware
 // ============
 //
-void TextLCD_init(void) 
+void TextLCD_init(MCP23017_DEVICE *port) 
 {
 uint8_t  i;
 //
 // Initialise pointer to MCP23017 object
 //
+    lcd_port = port;
 	DelayMs(1);
-    MCP23017_config(0x0F00, 0x0F00, 0x0F00);
+    MCP23017_config(lcd_port, 0x0F00, 0x0F00, 0x0F00);
 	DelayMs(1);    
-    _rows = 2;
-    _columns = 16;
+    _rows = LCD_ROWS;
+    _columns = LCD_COLUMNS;
 
     TextLCD_rw(0);
     TextLCD_e(0);
@@ -128,6 +133,17 @@ char  *ch_pt;
     }
 }
 
+//----------------------------------------------------------------------------
+// TextLCD_putstring_rom : output a null terminated string held in program memory
+// =====================
+//
+void   TextLCD_putstring_rom(const rom char* text)
+{
+    while (*text != '\0') {
+        TextLCD_putchar(*text++);
+    }
+}
+
 //----------------------------------------------------------------------------
 // TextLCD_newline : move cursor to the start of the next line
 // ===============
@@ -139,44 +155,9 @@ void TextLCD_newline(void)
     if(_row >= _rows) {
         _row = 0;
     }
-    TextLCD_locate(_column, _row); 
+    TextLCD_locate(_row, _column); 
 }
 
-//----------------------------------------------------------------------------
-// int16_to_string : convert INT16 to ASCII string
-// ===============
-//
-uint8_t int16_to_string(char *str, int16_t num) 
-{ 
-uint16_t   k; 
-char    c, *ostr;
-uint8_t   flag, ch_count;
-
-    ch_count = 0;
-	if (num < 0) { 
-		num = -num; 
-		*str++ = '-'; 
-        ch_count++;
-	} 
-	k = 10000; 
-	ostr = str;
-	flag = 0; 
-	while (k != 0) { 
-		c = num / k; 
-		if ((c > 0) || (k == 1) || (flag == 1)) { 
-			num %= k; 
-			c += '0'; 
-			*str++ = c; 
-            ch_count++;
-			flag = 1; 
-		} 
-		k /= 10; 
-	} 
-	*str = '\0'; 
-	return ch_count; 
-}
-
-
 //----------------------------------------------------------------------------
 // TextLCD_locate : move cursor to the specified (x,y) location
 // ==============
@@ -201,6 +182,15 @@ int  address;
 // ===========
 //
 void TextLCD_cls() {
+#ifdef I2C_TRACE
+uint8_t  i, j;
+
+    for (i=0 ; i < LCD_ROWS ; i++) {
+        for (j=0 ; j < LCD_COLUMNS ; j++) {
+            lcd_screen[i][j] = ' ';
+        }
+    }
+#endif
     TextLCD_writeCommand(CMD_CLEAR_DISPLAY);  // 0x01
     DelayMs(DISPLAY_CLEAR_DELAY);        // 
     TextLCD_locate(0, 0);
@@ -265,6 +255,9 @@ void TextLCD_writeCommand(uint8_t command) {
 void TextLCD_writeData(uint8_t data) {
     TextLCD_rs(1);
     TextLCD_writeByte(data);
+#ifdef I2C_TRACE
+    lcd_screen[_row][_column] = data;
+#endif
     _column++;
     if(_column >= _columns) {
         TextLCD_newline();
@@ -276,7 +269,7 @@ void TextLCD_writeData(uint8_t data) {
 // ==========
 //
 void TextLCD_rs(int data) {
-    MCP23017_write_bit(data, RS_BIT);
+    MCP23017_write_bit(lcd_port, data, RS_BIT);
 }
 
 //----------------------------------------------------------------------------
@@ -284,7 +277,7 @@ void TextLCD_rs(int data) {
 // ==========
 //
 void TextLCD_rw(int data) {
-    MCP23017_write_bit(data, RW_BIT);
+    MCP23017_write_bit(lcd_port, data, RW_BIT);
 }
 
 //----------------------------------------------------------------------------
@@ -292,7 +285,7 @@ void TextLCD_rw(int data) {
 // =========
 //
 void TextLCD_e(int data) {
-    MCP23017_write_bit(data, E_BIT);
+    MCP23017_write_bit(lcd_port, data, E_BIT);
 }
 
 //----------------------------------------------------------------------------
@@ -300,5 +293,5 @@ void TextLCD_e(int data) {
 // ==========
 //
 void TextLCD_d(int data) {
-    MCP23017_write_mask((unsigned short)data, (unsigned short)0x000F);
+    MCP23017_write_mask(lcd_port, (unsigned short)data, (unsigned short)0x000F);
 }
@@ -70,6 +70,17 @@
 #define     DISPLAY_CLEAR_DELAY          10       // 10 mS (spec is 6.2mS)
 #define     DISPLAY_CMD_DELAY             5       // delay to allow command to complete
 
+#define     LCD_ROWS                      2
+#define     LCD_COLUMNS                  16
+//
+// With I2C_TRACE defined, the characters written are also kept in
+// 'lcd_screen' so the expected display can be checked from the debugger
+// against the I2C trace.  It is blanked by TextLCD_cls().
+//
+#ifdef I2C_TRACE
+extern char  lcd_screen[LCD_ROWS][LCD_COLUMNS];
+#endif
+
 /** Class to access 16*2 LCD display connected to an MCP23017 I/O extender chip
  *
  * Derived from the "stream" class to be able to use methods such as "printf"
@@ -99,7 +110,7 @@
  *
  * @param   port    pointer to MCP23017 object
  */ 
-void TextLCD_init(void);
+void TextLCD_init(MCP23017_DEVICE *port);
     
 /** Set cursor to a known point
 *
@@ -124,8 +135,8 @@ void TextLCD_reset();
 
 uint8_t TextLCD_putchar(uint8_t c);   
 void    TextLCD_putstring(const char* text);     
+void    TextLCD_putstring_rom(const rom char* text);
 void    TextLCD_newline(void); 
-uint8_t int16_to_string(char *str, int16_t num);
     
 void TextLCD_clock();
 void TextLCD_writeData(uint8_t data);
@@ -132,3 +132,194 @@ void SetChanADC(unsigned char channel)
     ADCON0 = ((channel >> 1) & 0b00111100) | (ADCON0  & 0b11000011);
 
 }
+
+//************************************************************************
+//************************************************************************
+// PWM synchronised conversions and channel scanner
+//
+// Conversions are paced by the PWM timebase.  Timer2 matching PR2 starts
+// a new PWM period (output goes high), and its interrupt starts the first
+// of three chained conversions :-
+//
+//     1. right motor current   (sampled ~5uS into the on-phase)
+//     2. left motor current    (sampled ~25uS into the on-phase)
+//     3. the next scanner slot
+//
+// The motor samples are therefore taken at the same point in every PWM
+// period regardless of foreground activity.  The CCP special event
+// trigger cannot be used because both CCP units are in PWM mode.
+//
+// The scanner converts the channels of its list in round-robin order, one
+// per PWM period.  Each channel accumulates 2^ADC_OVERSAMPLE_LOG2
+// conversions; when every channel in the list has a full set, the
+// decimated values are written into the back half of a double-buffered
+// table and the buffers are swapped.  Readers therefore always see a
+// complete, consistent set of values with a single RAM load.
+//
+#define  ADC_PHASE_IDLE           0
+#define  ADC_PHASE_RIGHT_CURRENT  1
+#define  ADC_PHASE_LEFT_CURRENT   2
+#define  ADC_PHASE_SCAN           3
+
+#define  ADC_SELECT(chan)   ADCON0 = (((chan) << 2) & 0b00111100) | 0b00000001
+
+static uint8_t    scan_channels[ADC_SCAN_MAX_CHANNELS];
+static uint16_t   scan_sum[ADC_SCAN_MAX_CHANNELS];
+static uint8_t    scan_count;                // number of channels in list
+static uint8_t    scan_slot;                 // slot being converted
+static uint8_t    scan_pass;                 // conversions done per slot
+static uint8_t    adc_phase;                 // conversion in progress
+
+uint16_t          adc_table[2][ADC_SCAN_MAX_CHANNELS];
+volatile uint8_t  adc_front;                 // index of the readable half
+volatile uint8_t  adc_rounds;                // completed scan rounds
+
+//************************************************************************
+// ADC_Scan_Start : start PWM synchronised conversions and scanning
+// ==============
+//
+// Description
+//    The A/D unit must already have been configured with OpenADC() using
+//    right justification and ADC_INT_ON, and Timer2 must be running as
+//    the PWM timebase with a 1:1 postscaler.  An acquisition time must be
+//    selected in ADCON2 as GO is set immediately after changing channel.
+//
+void ADC_Scan_Start(const uint8_t *channel_list, uint8_t count)
+{
+uint8_t  i;
+
+    PIE1bits.TMR2IE = 0;
+    PIE1bits.ADIE = 0;
+    if (count > ADC_SCAN_MAX_CHANNELS) {
+        count = ADC_SCAN_MAX_CHANNELS;
+    }
+    for (i=0 ; i < count ; i++) {
+        scan_channels[i] = channel_list[i];
+        scan_sum[i] = 0;
+        adc_table[0][i] = 0;
+        adc_table[1][i] = 0;
+    }
+    scan_count = count;
+    scan_slot = 0;
+    scan_pass = 0;
+    adc_front = 0;
+    adc_rounds = 0;
+    adc_phase = ADC_PHASE_IDLE;
+
+    PIR1bits.ADIF = 0;
+    PIR1bits.TMR2IF = 0;
+    PIE1bits.ADIE = 1;
+    PIE1bits.TMR2IE = 1;
+    INTCONbits.PEIE = 1;
+}
+
+//************************************************************************
+// ADC_Scan_Stop : stop synchronised conversions
+// =============
+//
+void ADC_Scan_Stop(void)
+{
+    PIE1bits.TMR2IE = 0;
+    PIE1bits.ADIE = 0;
+    while(ADCON0bits.GO != 0) {
+        ;
+    }
+    PIR1bits.ADIF = 0;
+    adc_phase = ADC_PHASE_IDLE;
+}
+
+//************************************************************************
+// ADC_Trigger_ISR : start of PWM period interrupt handler
+// ===============
+//
+// Description
+//    Called from the interrupt service routine when TMR2IF is set.  If
+//    the previous chain has not finished (it should always have done) the
+//    period is skipped rather than disturbing the conversion in progress.
+//
+void ADC_Trigger_ISR(void)
+{
+    PIR1bits.TMR2IF = 0;
+    if (adc_phase != ADC_PHASE_IDLE) {
+        return;
+    }
+    ADC_SELECT(RIGHT_CURRENT_CHAN);
+    ADCON0bits.GO = 1;
+    adc_phase = ADC_PHASE_RIGHT_CURRENT;
+}
+
+//************************************************************************
+// ADC_ISR : A/D conversion complete interrupt handler
+// =======
+//
+// Description
+//    Called from the interrupt service routine when ADIF is set.  Routes
+//    the result according to the phase of the conversion chain and starts
+//    the next conversion of the chain.  A scanner result is first given to
+//    the obstacle reflex, then added to the current slot, and a new table
+//    published (and the battery filter updated) after the last pass of a
+//    round.
+//
+void ADC_ISR(void)
+{
+union ADCResult  result;
+uint8_t          i, back;
+
+    PIR1bits.ADIF = 0;
+    result.br[0] = ADRESL;
+    result.br[1] = ADRESH;
+
+    switch (adc_phase) {
+        case ADC_PHASE_RIGHT_CURRENT :
+            ADC_SELECT(LEFT_CURRENT_CHAN);
+            ADCON0bits.GO = 1;
+            adc_phase = ADC_PHASE_LEFT_CURRENT;
+            Motor_Current_Sample(RIGHT_MOTOR, result.lr);
+            break;
+
+        case ADC_PHASE_LEFT_CURRENT :
+            ADC_SELECT(scan_channels[scan_slot]);
+            ADCON0bits.GO = 1;
+            adc_phase = ADC_PHASE_SCAN;
+            Motor_Current_Sample(LEFT_MOTOR, result.lr);
+            break;
+
+        case ADC_PHASE_SCAN :
+            adc_phase = ADC_PHASE_IDLE;
+            Reflex_Check(scan_slot, result.lr);
+            scan_sum[scan_slot] += result.lr;
+            if (++scan_slot >= scan_count) {
+                scan_slot = 0;
+                if (++scan_pass >= ADC_OVERSAMPLE_COUNT) {
+                    scan_pass = 0;
+                    back = adc_front ^ 1;
+                    for (i=0 ; i < scan_count ; i++) {
+                        adc_table[back][i] = scan_sum[i] >> ADC_SCAN_SHIFT;
+                        scan_sum[i] = 0;
+                    }
+                    adc_front = back;
+                    adc_rounds++;
+                    Battery_Update(adc_table[back][BATTERY_SLOT]);
+                }
+            }
+            break;
+
+        default :
+            adc_phase = ADC_PHASE_IDLE;
+            break;
+    }
+}
+
+//************************************************************************
+// ADC_Scan_Value : latest filtered value for a scan slot
+// ==============
+//
+// Description
+//    Returns a (10 + ADC_EXTRA_BITS)-bit value.  The half being read is
+//    only rewritten after a further complete scan round, so the two byte
+//    load cannot be torn by the interrupt routine.
+//
+uint16_t ADC_Scan_Value(uint8_t slot)
+{
+    return (adc_table[adc_front][slot]);
+}
@@ -200,4 +200,28 @@ char BusyADC (void);
 
 uint16_t  ADC_Read(uint8_t channel);
 
+/* PWM synchronised conversions and channel scanner.
+ * Each PWM period converts both motor current channels followed by one
+ * scanner channel.  Up to ADC_SCAN_MAX_CHANNELS scanner channels are
+ * converted in turn, each oversampled 2^ADC_OVERSAMPLE_LOG2 times.  4^n
+ * samples give n extra bits of resolution, so with 16 samples the
+ * published values are 12-bit (0 -> 4092).  Values are indexed by their
+ * position (slot) in the list.
+ */
+#define ADC_SCAN_MAX_CHANNELS   8
+#define ADC_OVERSAMPLE_LOG2     4
+#define ADC_EXTRA_BITS          2
+#define ADC_OVERSAMPLE_COUNT    (1 << ADC_OVERSAMPLE_LOG2)
+#define ADC_SCAN_SHIFT          (ADC_OVERSAMPLE_LOG2 - ADC_EXTRA_BITS)
+
+extern uint16_t          adc_table[2][ADC_SCAN_MAX_CHANNELS];
+extern volatile uint8_t  adc_front;
+extern volatile uint8_t  adc_rounds;
+
+void      ADC_Scan_Start(const uint8_t *channel_list, uint8_t count);
+void      ADC_Scan_Stop(void);
+void      ADC_Trigger_ISR(void);
+void      ADC_ISR(void);
+uint16_t  ADC_Scan_Value(uint8_t slot);
+
 #endif
@@ -0,0 +1,108 @@
+//
+// battery.c : battery voltage monitoring and motor duty compensation
+//
+// The same requested speed should give the same motor speed on a fresh
+// or a flat pack.  Motor speed is roughly proportional to the average
+// voltage applied, so the duty is scaled by (nominal voltage / battery
+// voltage).  The scale factor is looked up from a table indexed by the
+// top 6 bits of the filtered battery value, so no division is needed at
+// run time.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// Compensation factor table (Q7, 128 == 1.0).  Entry i covers battery
+// voltages around (i + 0.5) * 156mV.  Below 5.5V the buggy is assumed to
+// be on a bench supply and no compensation is applied; the factor is
+// limited to 1.5.
+//
+rom static uint8_t  comp_table[64] = {
+    128, 128, 128, 128, 128, 128, 128, 128,   // 0.08V
+    128, 128, 128, 128, 128, 128, 128, 128,   // 1.33V
+    128, 128, 128, 128, 128, 128, 128, 128,   // 2.58V
+    128, 128, 128, 128, 128, 128, 128, 128,   // 3.83V
+    128, 128, 128, 166, 162, 157, 153, 149,   // 5.08V
+    146, 142, 139, 136, 133, 130, 127, 124,   // 6.33V
+    122, 119, 117, 115, 112, 110, 108, 106,   // 7.58V
+    104, 103, 101,  99,  97,  96,  94,  93,   // 8.83V
+};
+
+//************************************************************************
+// Global variables
+//
+volatile uint16_t  battery_filtered;     // 16 * 12-bit scanner value
+volatile uint8_t   battery_factor;       // current compensation factor
+
+static uint8_t     battery_low;
+
+//************************************************************************
+// Battery_Init : reset the battery filter
+// ============
+//
+void Battery_Init(void)
+{
+    battery_filtered = 0;
+    battery_factor = COMP_FACTOR_ONE;
+    battery_low = 0;
+}
+
+//************************************************************************
+// Battery_Update : filter a new battery sample
+// ==============
+//
+// Description
+//    Called at interrupt level each time the A/D scanner publishes a new
+//    table.  The first sample seeds the filter so that a low battery is
+//    not reported while the filter settles after reset.
+//
+void Battery_Update(uint16_t sample)
+{
+    if (battery_filtered == 0) {
+        battery_filtered = sample << BATTERY_FILTER_SHIFT;
+    } else {
+        battery_filtered = battery_filtered - (battery_filtered >> BATTERY_FILTER_SHIFT) + sample;
+    }
+    battery_factor = comp_table[battery_filtered >> 10];
+
+    if (battery_low == 0) {
+        if (battery_filtered < LOW_BATTERY_LEVEL) {
+            battery_low = 1;
+            seq_events |= EVENT_LOW_BATTERY;
+        }
+    } else {
+        if (battery_filtered > (LOW_BATTERY_LEVEL + LOW_BATTERY_HYSTERESIS)) {
+            battery_low = 0;
+        }
+    }
+}
+
+//************************************************************************
+// Battery_Compensate : scale a motor duty value for the battery voltage
+// ==================
+//
+uint16_t Battery_Compensate(uint16_t duty)
+{
+uint32_t  scaled;
+
+    scaled = ((uint32_t)duty * battery_factor) >> 7;
+    if (scaled > PWM_MAX_DUTY) {
+        scaled = PWM_MAX_DUTY;
+    }
+    return ((uint16_t)scaled);
+}
+
+//************************************************************************
+// Battery_Millivolts : filtered battery voltage in mV
+// ==================
+//
+uint16_t Battery_Millivolts(void)
+{
+uint16_t  filtered;
+
+    INTCONbits.GIE = 0;
+    filtered = battery_filtered;
+    INTCONbits.GIE = 1;
+    return ((uint16_t)(((uint32_t)filtered * BATTERY_FULL_SCALE_MV) >> 16));
+}
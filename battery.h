@@ -0,0 +1,38 @@
+//
+// battery.h : battery voltage monitoring and motor duty compensation
+//
+#ifndef _BATTERY_H
+#define _BATTERY_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// The battery (7.2V nominal pack) is connected to BATTERY_CHAN through a
+// 2:1 divider.  The filtered value is 16 * the 12-bit scanner value, so
+// full scale (65536) is 10V at the battery (~0.153mV per count).
+//
+#define     BATTERY_FULL_SCALE_MV    10000
+#define     BATTERY_NOMINAL_MV        7200
+#define     LOW_BATTERY_LEVEL        39322     // 6.0V
+#define     LOW_BATTERY_HYSTERESIS    1311     // 0.2V
+#define     BATTERY_FILTER_SHIFT         4     // filter gain 1/16 per scan round (~10mS)
+#define     COMP_FACTOR_ONE            128     // compensation factors are Q7
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern volatile uint16_t  battery_filtered;
+extern volatile uint8_t   battery_factor;
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void      Battery_Init(void);
+void      Battery_Update(uint16_t sample);
+uint16_t  Battery_Compensate(uint16_t duty);
+uint16_t  Battery_Millivolts(void);
+
+#endif //_BATTERY_H
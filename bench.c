@@ -0,0 +1,422 @@
+//
+// bench.c : on-target throughput benchmarks
+//
+// Built in when I2C_BENCHMARK is defined in defines.h.  The benchmark
+// runs at boot, after the display has been initialised, and times
+// transfers with the 1mS system tick.
+//
+// The number formatter benchmark is built in when FMT_BENCHMARK is
+// defined.  It times int16_to_asc() against the division based routine
+// it replaced with Timer1.
+//
+// The sequence interpreter benchmark is built in when SEQ_BENCHMARK is
+// defined.  It loads each of the reference programs below into the cache
+// in turn, runs it under the profiler and checks it against the baseline
+// measured on the reference buggy; a regression halts the boot.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+#ifdef I2C_BENCHMARK
+
+//************************************************************************
+// Global variables
+//
+I2C_BENCH   i2c_bench[2];
+
+//************************************************************************
+// bench_rate : convert a count over a number of mS to a rate per second
+// ==========
+//
+static uint16_t bench_rate(uint16_t count, uint16_t msecs)
+{
+    if (msecs == 0) {
+        msecs = 1;
+    }
+    return ((uint16_t)(((uint32_t)count * TICKS_PER_SECOND) / msecs));
+}
+
+//************************************************************************
+// I2C_Benchmark : measure bus and display throughput at both speeds
+// =============
+//
+// Description
+//    Bus throughput is measured with back-to-back writes of the GPIO
+//    register pair of expander 'dev' (4 bytes per transaction).  Display
+//    throughput is measured by filling the TextLCD screen.  The results are left in
+//    'i2c_bench' and shown on the display; the bus is then returned to
+//    the speed that was selected beforehand.
+//
+void I2C_Benchmark(MCP23017_DEVICE *dev)
+{
+uint8_t   speed, saved_speed, i;
+uint16_t  start, elapsed;
+char      number[8];
+
+    saved_speed = i2c_speed;
+    for (speed = I2C_SPEED_100KHZ ; speed <= I2C_SPEED_400KHZ ; speed++) {
+        I2C_Set_Speed(speed);
+
+        start = Tick_Get();
+        for (i=0 ; i < BENCH_I2C_WRITES ; i++) {
+            MCP23017_write_mask(dev, 0x0000, 0x0000);      // rewrite GPIO unchanged
+        }
+        elapsed = Tick_Elapsed(start);
+        i2c_bench[speed].bytes_per_sec = bench_rate(BENCH_I2C_WRITES * 4, elapsed);
+
+        TextLCD_locate(0,0);
+        start = Tick_Get();
+        for (i=0 ; i < BENCH_LCD_CHARS ; i++) {
+            TextLCD_putchar('0' + (i & 0x07));
+        }
+        elapsed = Tick_Elapsed(start);
+        i2c_bench[speed].chars_per_sec = bench_rate(BENCH_LCD_CHARS, elapsed);
+    }
+    I2C_Set_Speed(saved_speed);
+//
+// show "bytes/s chars/s" for 100kHz on row 0 and 400kHz on row 1
+//
+    TextLCD_cls();
+    for (speed = I2C_SPEED_100KHZ ; speed <= I2C_SPEED_400KHZ ; speed++) {
+        TextLCD_locate(speed, 0);
+        uint16_to_asc(number, i2c_bench[speed].bytes_per_sec, 5, 0);
+        TextLCD_putstring(number);
+        TextLCD_putchar(' ');
+        uint16_to_asc(number, i2c_bench[speed].chars_per_sec, 5, 0);
+        TextLCD_putstring(number);
+    }
+}
+
+#endif  // I2C_BENCHMARK
+
+#ifdef FMT_BENCHMARK
+
+//************************************************************************
+// Global variables
+//
+FMT_BENCH   fmt_bench;
+
+//************************************************************************
+// Module variables
+//
+rom static int16_t  fmt_bench_values[NOS_FMT_BENCH_VALUES] = {
+    0, 7, -42, 365, -1234, 10000, -32767, 32767
+};
+
+//************************************************************************
+// div_int16_to_asc : the division based conversion, kept for comparison
+// ================
+//
+// Notes
+//    A copy of the routine that int16_to_asc() replaced.  It does five
+//    16-bit divisions and modulos per number, each a library call.
+//
+static uint8_t div_int16_to_asc(char *str, int16_t num)
+{
+uint16_t   k;
+char       c;
+uint8_t    flag, ch_count;
+
+    ch_count = 0;
+    if (num < 0) {
+        num = -num;
+        *str++ = '-';
+        ch_count++;
+    }
+    k = 10000;
+    flag = 0;
+    while (k != 0) {
+        c = num / k;
+        if ((c > 0) || (k == 1) || (flag == 1)) {
+            num %= k;
+            *str++ = c + '0';
+            ch_count++;
+            flag = 1;
+        }
+        k /= 10;
+    }
+    *str = '\0';
+    return ch_count;
+}
+
+//************************************************************************
+// Fmt_Benchmark : compare the two number formatters
+// =============
+//
+// Description
+//    Converts the same set of numbers with each routine, timed with
+//    Timer1, and shows the mean instruction cycles per number for 2
+//    seconds as
+//
+//        Row 0 : "DIV  ccccc cy"
+//        Row 1 : "SUB  ccccc cy"
+//
+// Notes
+//    Timer1 is set up as for I2C_STATS and SEQ_PROFILE.  Interrupts are
+//    left running, so the figures include a little interrupt time.
+//
+void Fmt_Benchmark(void)
+{
+uint8_t   i;
+uint16_t  start, elapsed;
+char      number[8];
+
+    OpenTimer1(TIMER_INT_OFF & T1_16BIT_RW & T1_SOURCE_INT & T1_PS_1_8 & T1_OSC1EN_OFF & T1_SYNC_EXT_OFF);
+
+    start = ReadTimer1();
+    for (i=0 ; i < NOS_FMT_BENCH_VALUES ; i++) {
+        div_int16_to_asc(number, fmt_bench_values[i]);
+    }
+    elapsed = ReadTimer1() - start;
+    fmt_bench.old_cycles = (uint16_t)(((uint32_t)elapsed * BENCH_TIMER1_CYCLES) / NOS_FMT_BENCH_VALUES);
+
+    start = ReadTimer1();
+    for (i=0 ; i < NOS_FMT_BENCH_VALUES ; i++) {
+        int16_to_asc(number, fmt_bench_values[i]);
+    }
+    elapsed = ReadTimer1() - start;
+    fmt_bench.new_cycles = (uint16_t)(((uint32_t)elapsed * BENCH_TIMER1_CYCLES) / NOS_FMT_BENCH_VALUES);
+
+    TextLCD_cls();
+    TextLCD_locate(0,0);
+    TextLCD_putstring_rom("DIV  ");
+    uint16_to_asc(number, fmt_bench.old_cycles, 5, 0);
+    TextLCD_putstring(number);
+    TextLCD_putstring_rom(" cy");
+    TextLCD_locate(1,0);
+    TextLCD_putstring_rom("SUB  ");
+    uint16_to_asc(number, fmt_bench.new_cycles, 5, 0);
+    TextLCD_putstring(number);
+    TextLCD_putstring_rom(" cy");
+    DelayBigMs(2000);
+}
+
+#endif  // FMT_BENCHMARK
+
+#ifdef SEQ_BENCHMARK
+
+//************************************************************************
+// Reference programs
+//
+// Each is loaded into the program cache on its own and run from line 0.
+//
+rom static SEQ_ENTRY bench_loop[] = {       // DECSKIP/JUMP loop (runs as DJNZ)
+//           command  |     param1 |     param2 |    param3
+            {SETVAR   ,         V0 ,        200 ,         0 },
+            {DECSKIP  ,         V0 ,          0 ,         0 },
+            {JUMP     ,          1 ,          0 ,         0 },
+            {FINISH   ,          0 ,          0 ,         0 },
+};
+
+rom static SEQ_ENTRY bench_calc[] = {       // CALC
+            {SETVAR   ,         V3 ,        100 ,         0 },
+            {CALC     ,        ADD ,         V1 ,         1 },
+            {CALC     ,        ADD ,         V2 ,         3 },
+            {CALC     ,        ADD ,         V1 ,        -1 },
+            {CALC     ,        ADD ,         V2 ,        -3 },
+            {DECSKIP  ,         V3 ,          0 ,         0 },
+            {JUMP     ,          1 ,          0 ,         0 },
+            {FINISH   ,          0 ,          0 ,         0 },
+};
+
+rom static SEQ_ENTRY bench_rand[] = {       // LOAD_RAND
+            {SETVAR   ,         V3 ,        100 ,         0 },
+            {LOAD_RAND,         V1 ,          0 ,       100 },
+            {LOAD_RAND,         V2 ,          1 ,         6 },
+            {DECSKIP  ,         V3 ,          0 ,         0 },
+            {JUMP     ,          1 ,          0 ,         0 },
+            {FINISH   ,          0 ,          0 ,         0 },
+};
+
+rom static SEQ_ENTRY bench_motor[] = {      // SETSPEED/START/STOP (motors run : wheels clear of the ground)
+            {SETVAR   ,         V3 ,         50 ,         0 },
+            {SETSPEED ,  IMMEDIATE ,         20 ,        20 },
+            {START    ,          0 ,          0 ,         0 },
+            {SETSPEED ,  IMMEDIATE ,        -20 ,       -20 },
+            {START    ,          0 ,          0 ,         0 },
+            {STOP     ,          0 ,          0 ,         0 },
+            {DECSKIP  ,         V3 ,          0 ,         0 },
+            {JUMP     ,          1 ,          0 ,         0 },
+            {FINISH   ,          0 ,          0 ,         0 },
+};
+
+rom static SEQ_ENTRY bench_repeat[] = {     // REPEAT/END loop : same work as bench_loop
+            {REPEAT   ,  IMMEDIATE ,        200 ,         0 },
+            {END      ,          0 ,          0 ,         0 },
+            {FINISH   ,          0 ,          0 ,         0 },
+};
+
+rom static SEQ_ENTRY bench_show[] = {       // SHOWVAR : display queue posting
+            {SETVAR   ,         V3 ,        100 ,         0 },
+            {SHOWVAR  ,         V3 ,          1 ,        10 },
+            {DECSKIP  ,         V3 ,          0 ,         0 },
+            {JUMP     ,          1 ,          0 ,         0 },
+            {FINISH   ,          0 ,          0 ,         0 },
+};
+
+#define  BENCH_LINES(program)   (sizeof(program) / sizeof(program[0]))
+
+//
+// Baselines are mean instruction cycles per dispatched command on the
+// reference buggy.  Update them on purpose : run a BENCH_RECORD build and
+// copy the measured figures (row 1 of each result screen) in here.  A
+// baseline of 0 has not been recorded and the program is reported as a
+// failure (NONE) until it is.
+//
+rom static struct {
+    const rom SEQ_ENTRY  *program;
+    uint8_t              lines;
+    char                 name[6];
+    uint16_t             baseline;
+} seq_bench_list[NOS_SEQ_BENCH] = {
+    {bench_loop,   BENCH_LINES(bench_loop),   "LOOP",  0},
+    {bench_calc,   BENCH_LINES(bench_calc),   "CALC",  0},
+    {bench_rand,   BENCH_LINES(bench_rand),   "RAND",  0},
+    {bench_motor,  BENCH_LINES(bench_motor),  "MOTOR", 0},
+    {bench_repeat, BENCH_LINES(bench_repeat), "RPT",   0},
+    {bench_show,   BENCH_LINES(bench_show),   "SHOW",  0},
+};
+
+#if (1 + (2 * NOS_SEQ_BENCH)) > BENCH_EE_SIZE
+#error "BENCH_EE_SIZE too small for NOS_SEQ_BENCH baselines"
+#endif
+
+//************************************************************************
+// Global variables
+//
+SEQ_BENCH   seq_bench[NOS_SEQ_BENCH];
+
+//************************************************************************
+// bench_bus_time : total time spent on the I2C bus
+// ==============
+//
+// Description
+//    Returns the sum of the I2C_STATS busy counters (Timer1 counts), or
+//    0 when the statistics are not built in.
+//
+static uint32_t bench_bus_time(void)
+{
+#ifdef I2C_STATS
+uint8_t   i;
+uint32_t  total;
+
+    total = 0;
+    for (i=0 ; i < I2C_STATS_DEVICES ; i++) {
+        total += i2c_stats[i].busy;
+    }
+    return total;
+#else
+    return 0;
+#endif
+}
+
+//************************************************************************
+// Seq_Benchmark : run the reference sequences and check for regressions
+// =============
+//
+// Description
+//    Each program is run to its FINISH with the profiler reset, and the
+//    mean cycles per command is compared with its baseline (the built-in
+//    figure, or this board's override in data EEPROM).  The result is
+//    shown on the display for 2 seconds as
+//
+//        Row 0 : "name  bbb.b PASS"  bus time in mS (I2C_STATS), verdict
+//        Row 1 : "ccccc/bbbbb cy"    measured / baseline cycles
+//
+//    The verdict is NONE, a failure, when there is no baseline.  In a
+//    BENCH_RECORD build it is REC : the measured figure is stored as the
+//    board's override and nothing fails.  A summary of the number of
+//    failures is shown last.
+//
+//    Returns the number of programs that failed.
+//
+// Notes
+//    Each reference program replaces the contents of the program cache,
+//    so the caller must reload the vehicle's program afterwards.
+//
+uint8_t Seq_Benchmark(void)
+{
+uint8_t   i, failures, override;
+uint16_t  baseline, stored;
+uint32_t  bus_start, bus_time;
+char      number[8];
+
+    failures = 0;
+    override = (EEPROM_Read(BENCH_EE_BASE) == BENCH_EE_MAGIC);
+    for (i=0 ; i < NOS_SEQ_BENCH ; i++) {
+        Seq_Load_Rom(seq_bench_list[i].program, seq_bench_list[i].lines);
+        Profile_Reset();
+        bus_start = bench_bus_time();
+        exec_seq(&seq, 0);
+        seq_bench[i].cycles = Profile_Cycles_Per_Command();
+        Display_Init();                 // discard anything a program posted
+        bus_time = (bench_bus_time() - bus_start) / (I2C_STATS_COUNTS_PER_MS / 10);
+        seq_bench[i].bus_time = (bus_time > 9999) ? 9999 : (uint16_t)bus_time;
+
+        baseline = seq_bench_list[i].baseline;
+        if (override) {
+            stored = EEPROM_Read(BENCH_EE_BASE + 1 + (2 * i)) |
+                     ((uint16_t)EEPROM_Read(BENCH_EE_BASE + 2 + (2 * i)) << 8);
+            if (stored != 0) {
+                baseline = stored;
+            }
+        }
+        seq_bench[i].baseline = baseline;
+#ifdef BENCH_RECORD
+        EEPROM_Write(BENCH_EE_BASE + 1 + (2 * i), (uint8_t)seq_bench[i].cycles);
+        EEPROM_Write(BENCH_EE_BASE + 2 + (2 * i), (uint8_t)(seq_bench[i].cycles >> 8));
+        seq_bench[i].passed = 1;
+#else
+        seq_bench[i].passed = ((baseline != 0) &&
+            (seq_bench[i].cycles <= (baseline + (baseline >> SEQ_BENCH_TOLERANCE_SHIFT))));
+        if (!seq_bench[i].passed) {
+            failures++;
+        }
+#endif
+
+        TextLCD_cls();
+        TextLCD_locate(0,0);
+        TextLCD_putstring_rom(seq_bench_list[i].name);
+        TextLCD_locate(0,6);
+#ifdef I2C_STATS
+        fixed16_to_asc(number, (int16_t)seq_bench[i].bus_time, 1, 5, 0);
+        TextLCD_putstring(number);
+#else
+        TextLCD_putstring_rom("  ---");
+#endif
+        TextLCD_locate(0,12);
+#ifdef BENCH_RECORD
+        TextLCD_putstring_rom("REC");
+#else
+        if (baseline == 0) {
+            TextLCD_putstring_rom("NONE");
+        } else {
+            TextLCD_putstring_rom((seq_bench[i].passed) ? "PASS" : "FAIL");
+        }
+#endif
+        TextLCD_locate(1,0);
+        uint16_to_asc(number, seq_bench[i].cycles, 5, 0);
+        TextLCD_putstring(number);
+        TextLCD_putchar('/');
+        uint16_to_asc(number, baseline, 5, 0);
+        TextLCD_putstring(number);
+        TextLCD_putstring_rom(" cy");
+        DelayBigMs(2000);
+    }
+#ifdef BENCH_RECORD
+    EEPROM_Write(BENCH_EE_BASE, BENCH_EE_MAGIC);
+#endif
+
+    TextLCD_cls();
+    TextLCD_locate(0,0);
+    TextLCD_putstring_rom("SEQ BENCH");
+    TextLCD_locate(1,0);
+    uint16_to_asc(number, failures, 1, 0);
+    TextLCD_putstring(number);
+    TextLCD_putstring_rom(" FAILED");
+    DelayBigMs(2000);
+    return failures;
+}
+
+#endif  // SEQ_BENCHMARK
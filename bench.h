@@ -0,0 +1,83 @@
+//
+// bench.h : on-target throughput benchmarks
+//
+#ifndef _BENCH_H
+#define _BENCH_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+#define     BENCH_I2C_WRITES      250     // 16-bit register writes per measurement
+#define     BENCH_LCD_CHARS        32     // characters per measurement (full 2*16 screen)
+#define     BENCH_TIMER1_CYCLES     8     // instruction cycles per Timer1 count (1:8 prescale)
+#define     NOS_FMT_BENCH_VALUES    8     // numbers converted per formatter measurement
+//
+// Reference sequence programs (see bench.c).  Each is loaded into the
+// program cache on its own, so none may be longer than SEQ_MAX_LINES.
+//
+#define     NOS_SEQ_BENCH           6
+//
+// A result more than 1/(2^SEQ_BENCH_TOLERANCE_SHIFT) above its baseline
+// (12.5%) is a regression
+//
+#define     SEQ_BENCH_TOLERANCE_SHIFT   3
+//
+// Baselines are the figures measured on the reference buggy, kept with the
+// programs in bench.c and updated on purpose after an intended change to
+// the interpreter.  A board can override them with its own figures in the
+// top of data EEPROM, written only by a BENCH_RECORD build.  A non-zero
+// entry there replaces the built-in baseline for that program.
+//
+//    BENCH_EE_BASE + 0         BENCH_EE_MAGIC
+//                  + 1 + 2*n   baseline of program n (low byte first)
+//
+#define     BENCH_EE_SIZE          16
+#define     BENCH_EE_BASE          (EEPROM_SIZE - BENCH_EE_SIZE)
+#define     BENCH_EE_MAGIC         0xB1
+
+#if defined(SEQ_BENCHMARK) && !defined(SEQ_PROFILE)
+#error "SEQ_BENCHMARK needs SEQ_PROFILE"
+#endif
+#if defined(BENCH_RECORD) && !defined(SEQ_BENCHMARK)
+#error "BENCH_RECORD needs SEQ_BENCHMARK"
+#endif
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+typedef struct {
+       uint16_t  bytes_per_sec;       // raw I2C bytes (address and data) per second
+       uint16_t  chars_per_sec;       // TextLCD characters per second
+} I2C_BENCH;
+
+typedef struct {
+       uint16_t  old_cycles;          // mean cycles per number : division based formatter
+       uint16_t  new_cycles;          // mean cycles per number : int16_to_asc()
+} FMT_BENCH;
+
+typedef struct {
+       uint16_t  cycles;              // mean instruction cycles per dispatched command
+       uint16_t  baseline;            // cycles it was checked against
+       uint16_t  bus_time;            // I2C_STATS : time on the I2C bus, 0.1mS units
+       uint8_t   passed;              // 1 if within tolerance of the baseline
+} SEQ_BENCH;
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern I2C_BENCH   i2c_bench[2];      // indexed by I2C_SPEED_xxx
+extern SEQ_BENCH   seq_bench[NOS_SEQ_BENCH];
+extern FMT_BENCH   fmt_bench;
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void  I2C_Benchmark(MCP23017_DEVICE *dev);
+uint8_t  Seq_Benchmark(void);
+void     Fmt_Benchmark(void);
+
+#endif //_BENCH_H
@@ -11,6 +11,8 @@
 //    Program uses a simple language to describe commands.  Sequences of these commands are stored in the 
 //    C structure (table) 'sequence'.  This table is then executed indefinitely, or until it reaches a
 //    FINNISH command.  Each command has up to 3 parameters. 
+//    The table is copied to RAM at boot and run from there; a program loaded into data EEPROM over
+//    the serial port (SEQ_LOADER, see seq_load.c) replaces it.
 //    Language commands are as follows :- (unused parameters are shown as ---)
 //
 //                                                      | PARAMETER_1     |   PARAMETER_2      |  PARAMETER_3
@@ -23,6 +25,30 @@
 //  ------------------------------------------------------------------------------------------------------------
 //   JUMP        : jump to a program position           | line number     |     ---            |    ---
 //  ------------------------------------------------------------------------------------------------------------
+//   DJNZ        : decrement a variable and jump if it  |   variable      |   line number      |    ---
+//                 is not zero, else skip the next line |                 |                    |
+//  ------------------------------------------------------------------------------------------------------------
+//   SETGO       : SETSPEED then START (next line)      |     Mode        | as SETSPEED        | as SETSPEED
+//  ------------------------------------------------------------------------------------------------------------
+//   PRINT       : show a fixed string                  | string          |     row            |  column
+//                                                      | (STR_xxx, see   |                    |
+//                                                      |  ui_strings.h)  |                    |
+//  ------------------------------------------------------------------------------------------------------------
+//   SHOWVAR     : show a variable (6 characters)       |   variable      |     row            |  column
+//  ------------------------------------------------------------------------------------------------------------
+//   SHOWSPEED   : show the motor speeds (% full speed) |     ---         |     row            |  column
+//                 as "R+100 L-100"                     |                 |                    |
+//  ------------------------------------------------------------------------------------------------------------
+//   CALL        : call a subsequence                   | line number     |     ---            |    ---
+//  ------------------------------------------------------------------------------------------------------------
+//   RETURN      : return to the line after the CALL    |     ---         |     ---            |    ---
+//  ------------------------------------------------------------------------------------------------------------
+//   REPEAT      : run the lines up to the matching END |     Mode        |    count           |    ---
+//                 'count' times                        |   IMMEDIATE     |    constant        |
+//                                                      |   REGISTER      |    variable        |
+//  ------------------------------------------------------------------------------------------------------------
+//   END         : end of a REPEAT block                |     ---         |     ---            |    ---
+//  ------------------------------------------------------------------------------------------------------------
 //   DECSKIP     : decrement a variable and skip next   |                 |                    |
 //                 command if variable is zero          |   variable      |     ---            |    ---
 //  ------------------------------------------------------------------------------------------------------------
@@ -32,6 +58,12 @@
 //                                                      |                 |    EQUAL_TO        | 
 //                                                      |                 |    LESS_THAN       | 
 //  ------------------------------------------------------------------------------------------------------------
+//   EVENTSKIP   : skip next command if any of the      |                 |                    |
+//                 events are pending, and clear them   |   event mask    |     ---            |    ---
+//                                                      |  EVENT_OBSTACLE |                    |
+//                                                      |  EVENT_STALL    |                    |
+//                                                      |EVENT_LOW_BATTERY|                    |
+//  ------------------------------------------------------------------------------------------------------------
 //   SETSPEED    : set speed to the two drive motors    |     Mode        | % full speed of    |  % full speed  
 //                                                      |                 | vehicle RIGHT motor| ovehicle LEFT motor
 //                                                      |                 |                    |
@@ -57,6 +89,31 @@
 //    where the values are stored.  The variables are named V0 to V9.  You can do some simple arithmetic
 //    operations on these variables.
 //
+//    PRINT, SHOWVAR and SHOWSPEED do not write to the display themselves.  They post a request to
+//    the display queue (see display.c), which is written out during WAITs and after the sequence has
+//    finished, so they take almost no time.  The value shown is the one when the command ran.
+//
+//    DJNZ and SETGO are superinstructions.  When the program is loaded into the RAM cache, each
+//    DECSKIP followed by a JUMP is rewritten as a DJNZ and each SETSPEED followed by a START as a
+//    SETGO (see seq_load.c), so a loop or a speed change costs one dispatch instead of two.  The
+//    second line is left in place, so line numbers do not change and a JUMP to it still works.
+//
+//    CALLs nest SEQ_CALL_DEPTH deep and REPEAT blocks SEQ_LOOP_DEPTH deep (see seq.h).  The REPEAT
+//    count is copied to a hidden counter, so a block does not use up a variable and its loop costs
+//    one END per pass.  A count of zero or less skips the block.  A CALL or REPEAT that would go
+//    too deep, or a RETURN or END with nothing to match it, stops the motors and ends the sequence.
+//    Leave a REPEAT block only through its END and a subroutine only through its RETURN : a JUMP
+//    or DJNZ out of one does not pop its entry, so the next END or RETURN goes back into the block
+//    that was left, and a block left inside a loop soon makes the sequence stop as too deep.
+//
+//    Events are raised by the obstacle reflex and the motor stall protection, which stop the motors
+//    at interrupt level without waiting for the sequence, and when the battery voltage falls below
+//    LOW_BATTERY_LEVEL.  A WAIT ends early (within about 20mS) if a new event is raised during it,
+//    so the sequence can react with EVENTSKIP.
+//
+//    Motor duty is scaled by the measured battery voltage when the motors are started, so a given
+//    SETSPEED gives the same speed on a fresh or a flat battery.
+//
 // Target configuration:
 //    MCU         :   P18F4585
 //    Oscillator  :   HS, 40.0000MHz
@@ -85,18 +142,10 @@
 
 #if defined(__18F452)
 #include   <p18f452.h>
-#define RIGHT_MOTOR_DIR_TRIS   	TRISBbits.TRISB0 
-#define RIGHT_MOTOR_DIR			PORTBbits.RB0
-#define LEFT_MOTOR_DIR_TRIS   	TRISBbits.TRISB1 
-#define LEFT_MOTOR_DIR  		PORTBbits.RB1
 #endif
 
 #if defined(__18F4585)
 #include    <p18f4585.h>  
-#define RIGHT_MOTOR_DIR_TRIS   	TRISBbits.TRISB5 
-#define RIGHT_MOTOR_DIR			PORTBbits.RB5
-#define LEFT_MOTOR_DIR_TRIS   	TRISBbits.TRISB4 
-#define LEFT_MOTOR_DIR  		PORTBbits.RB4
 #endif
 
 //----------------------------------------------------------------------------
@@ -109,37 +158,29 @@
 #define     OFF_PWM      0     // base PWM value == stopped
 #define     FULL_PWM     4  
 
-#define     SET_FORWARD  0
-#define     SET_REVERSE  1
-
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
-// Sequence definitions
-//
-typedef enum {SETSPEED, FINISH, START, STOP, WAIT, JUMP, SETVAR, LOAD_RAND, 
-              DECSKIP, CALC, TESTSKIP
-} COMMAND;
-typedef enum {FULL_SPEED=100, HALF_SPEED=50} SPEED;  // % value
-typedef enum {RUNNING, STOPPED} SEQ_STATE;
-typedef enum {FORWARD, BACKWARD} DIRECTION;
-enum {V0, V1, V2, V3, V4, V5, V6, V7, V8, V9} var_names;
-enum {IMMEDIATE, REGISTER} cmd_modes;
-enum {ADD} arith_ops;
+// A/D channels converted by the interrupt driven scanner (order == slot)
+//
+static uint8_t adc_scan_list[NOS_SCAN_SLOTS] = {IR_LEFT_CHAN, IR_RIGHT_CHAN, BATTERY_CHAN};
 
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
-// System character strings
+// I2C devices that must work at 400kHz before the bus is switched to it
 //
-static char st1[] = "Int = ";
+rom static I2C_PROBE i2c_devices[] = {
+    {MCP23017_ADDRESS,   IODIR, 2},       // breakout board I/O expander : direction registers
+    {LCD03_ADDRESS, REGISTER_3, 1},       // LCD03 display (if fitted) : software version
+};
+#define  NOS_I2C_DEVICES   (sizeof(i2c_devices) / sizeof(i2c_devices[0]))
 
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
-// Storage structure for vehicle sequence program
+// Built-in vehicle sequence program.  It is copied into the RAM cache
+// 'seq_program[]' at boot unless a program has been loaded into data
+// EEPROM (see seq_load.c).
 //
-rom static struct  {
-    COMMAND   cmd;
-    int       param1, param2, param3;
-} sequence[] = {
+rom static SEQ_ENTRY sequence[] = {
 //           command  |     param1 |     param2 |    param3
             {WAIT     ,          5 ,          0 ,         0 },  //  initial 5 second delay  
             {SETSPEED ,  IMMEDIATE , FULL_SPEED , FULL_SPEED},  // full speed ahead
@@ -169,8 +210,9 @@ rom static struct  {
             {CALC     ,        ADD ,         V1 ,        10 },  // add 10%
             {DECSKIP  ,         V2 ,          0 ,         0 },
             {JUMP     ,         18 ,          0 ,         0 },
-            {FINISH   ,          0 ,          0 ,         0 }
+            {FINISH   ,          0 ,          0 ,         0 },
         };
+#define  NOS_SEQUENCE_LINES   (sizeof(sequence) / sizeof(sequence[0]))
 
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
@@ -181,17 +223,19 @@ void OpenBoth_PWM( uint8_t period );
 void init(void);
 void SetDutyCyclePWM1(unsigned int dutycycle);
 void SetDutyCyclePWM2(unsigned int dutycycle);
-void exec_seq( uint8_t seq_start_no );
+void seq_wait( SEQ_CONTEXT *ctx, uint8_t seconds );
 
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
 // Program variables
 //
-int    	vars[10];                          // user variables : vars[0] to vars[9]
-int    	right_speed, left_speed;
-uint8_t	left_direction, right_direction;
-int    	left_offset, right_offset;
+SEQ_CONTEXT       seq;                     // see seq.h
 char	 tmp_string[20];
+volatile uint8_t  seq_events;              // see events.h
+MCP23017_DEVICE   io_port;                 // breakout board expander (LCD, LEDs, switches)
+#ifdef SEQ_LOADER
+uint8_t           loader_status;           // last Seq_Loader_Poll() result
+#endif
 
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
@@ -263,7 +307,7 @@ int tmp_int;
 //
 // Configure 2 PWM hardware subsystems for driving motors.
 //
-    OpenBoth_PWM( 124 );
+    OpenBoth_PWM( PWM_PERIOD );
 //
 //    SetDCPWM2(0);        // 18f452
 //
@@ -280,159 +324,479 @@ int tmp_int;
 //
 // initialise system variables.
 //
-    left_speed = 0;
-    left_direction = FORWARD;
-    left_offset = 0;
+    Seq_Init(&seq);
+    Seq_Load_Program(sequence, NOS_SEQUENCE_LINES);
+    Display_Init();
+//
+// arm the obstacle reflex on both IR distance sensors
+//
+    seq_events = 0;
+    Battery_Init();
+    Reflex_Init();
+    Reflex_Set(IR_LEFT_SLOT, OBSTACLE_THRESHOLD);
+    Reflex_Set(IR_RIGHT_SLOT, OBSTACLE_THRESHOLD);
 //
-    right_speed = 0;
-    right_direction = FORWARD;
-    right_offset = 0;
+// set interrupt priorities (see interrupts.h) and start the system tick
+//
+    Interrupts_Init();
+    Tick_Init();
+#ifdef I2C_STATS
+    I2C_Stats_Init();
+#endif
+#ifdef I2C_SIM
+    I2C_Sim_Init();
+#endif
+#ifdef SEQ_PROFILE
+    Profile_Init();
+#endif
+#ifdef RUN_LOG
+    Run_Log_Init();
+#endif
+#ifdef ODOMETRY
+    Odometry_Init();
+#endif
+#ifdef TELEMETRY
+    Telemetry_Init();
+#endif
+#ifdef SEQ_LOADER
+    Seq_Loader_Init();
+    loader_status = LOADER_IDLE;
+#endif
 //
-// initialise random number generator
+// start the PWM synchronised A/D conversions : Fosc/32 clock (0.8uS Tad)
+// with 6 Tad acquisition gives ~14uS per conversion, so the three
+// conversions per 200uS PWM period finish well inside the period.
 //
-    srand(143);
+    Motor_Current_Init();
+    OpenADC(ADC_FOSC_32 & ADC_RIGHT_JUST & ADC_6_TAD,
+            ADC_CH0 & ADC_INT_ON & ADC_VREFPLUS_VDD & ADC_VREFMINUS_VSS,
+            ADC_5ANA);
+    ADC_Scan_Start(adc_scan_list, NOS_SCAN_SLOTS);
+    Interrupts_Enable();
 //
 // initialise the I2C interface
 //
     DelayMs(1000);
     I2C_Open(MASTER, SLEW_OFF);
-    SSPADD = I2C_100KHZ; 
+    I2C_Set_Speed(I2C_SPEED_100KHZ);
     I2C_Idle();
     DelayMs(1);
 //
-// Initialise the MCP23017 I/O device
+// Initialise the MCP23017 I/O device, then move the bus to 400kHz if all
+// the fitted devices work at that speed
 //
-	MCP23017_reset(0x20);
-    MCP23017_write_bit(1,BL_BIT);   // BL_BIT
-    MCP23017_write_bit(1,15);       // LED_4
+	MCP23017_reset(&io_port, MCP23017_ADDRESS);
+    I2C_Probe_Speed(i2c_devices, NOS_I2C_DEVICES);
+    MCP23017_post_bit(&io_port, 1,BL_BIT);    // BL_BIT
+    MCP23017_post_bit(&io_port, 1,15);        // LED_4
 
-	TextLCD_init();
+	TextLCD_init(&io_port);
 	TextLCD_locate(0,0);
-	TextLCD_putstring(st1);
+	TextLCD_putstring_rom(ui_strings[STR_INT]);
 	tmp_int = 43;
-	int16_to_string(tmp_string, tmp_int);
+	int16_to_asc(tmp_string, tmp_int);
 	TextLCD_putstring(tmp_string);
 	TextLCD_locate(1,3);
 	TextLCD_putchar('4');
 	TextLCD_putchar('5');
 
-    MCP23017_write_bit(1,14);       // LED_4
+#ifdef I2C_BENCHMARK
+    I2C_Benchmark(&io_port);
+#endif
+#ifdef FMT_BENCHMARK
+    Fmt_Benchmark();
+#endif
+#ifdef I2C_STATS
+    I2C_Stats_Show(0);                  // boot traffic to the first device used
+#endif
+#ifdef SEQ_BENCHMARK
+    if (Seq_Benchmark() != 0) {
+        MOTORS_OFF();                   // interpreter regression : halt here
+        for (;;) {
+            Tick_Idle();
+        }
+    }
+    Seq_Load_Program(sequence, NOS_SEQUENCE_LINES);     // the benchmark used the cache
+    Seq_Init(&seq);                     // and left its variables and LOAD_RAND seed
+#endif
+
+    MCP23017_post_bit(&io_port, 1,14);        // LED_4
+    I2C_Flush();
 
     return;
 }
 
+//----------------------------------------------------------------------------
+// Seq_Init : set a sequence context to its power-on state
+// ========
+//
+void Seq_Init(SEQ_CONTEXT *ctx)
+{
+uint8_t   i;
+
+    for (i=0 ; i < NOS_VARS ; i++) {
+        ctx->vars[i] = 0;
+    }
+    ctx->left_speed = 0;
+    ctx->left_direction = FORWARD;
+    ctx->left_offset = 0;
+//
+    ctx->right_speed = 0;
+    ctx->right_direction = FORWARD;
+    ctx->right_offset = 0;
+//
+    ctx->seq_counter = 0;
+    ctx->call_depth = 0;
+    ctx->loop_depth = 0;
+    ctx->rand_seed = SEQ_RAND_SEED;
+    ctx->state = STOPPED;
+}
+
+//----------------------------------------------------------------------------
+// seq_rand : next LOAD_RAND value of a context
+// ========
+//
+// Notes
+//    16-bit linear congruential generator; the result is the top 15 bits
+//    (0 to 32767, as rand()).  Keeping the state in the context makes a
+//    run repeatable from Seq_Init().
+//
+static int seq_rand(SEQ_CONTEXT *ctx)
+{
+    ctx->rand_seed = (ctx->rand_seed * 25173) + 13849;
+    return ((int)(ctx->rand_seed >> 1));
+}
+
+//----------------------------------------------------------------------------
+// seq_wait : delay for a number of seconds
+// ========
+//
+// Notes
+//    The wait is timed by the system tick and ends early if a new event
+//    is raised, so that the sequence can respond to it.  Events are
+//    checked at the start of each pass, before the slow display write,
+//    so the response is delayed by at most the pass in progress when the
+//    event was raised (one display request, about 15-20mS).
+//    Posted I2C writes (LEDs etc.) and queued display updates are sent,
+//    and the optional odometry, run log and telemetry are serviced, on
+//    each pass of the loop.  With SEQ_LOADER the serial loader is polled
+//    too, and once a load begins the motors are stopped and the sequence
+//    is abandoned so that main() can run the new program.  Between
+//    passes the CPU idles until the next interrupt (see Tick_Idle),
+//    which is at most one tick away.
+//
+void seq_wait(SEQ_CONTEXT *ctx, uint8_t seconds)
+{
+uint8_t   old_events;
+uint16_t  start;
+
+    old_events = seq_events;
+    start = Tick_Get();
+    while (seconds != 0) {
+        if (seq_events & ~old_events) {
+            return;
+        }
+        I2C_Flush();
+        Display_Task();
+#ifdef I2C_STATS
+        I2C_Stats_Update();
+#endif
+#ifdef ODOMETRY
+        Odometry_Update();
+#endif
+#ifdef TELEMETRY
+        Telemetry_Poll(ctx);
+#endif
+#ifdef RUN_LOG
+        Run_Log_Poll();
+        Run_Log_Flush();
+#endif
+#ifdef SEQ_LOADER
+        loader_status = Seq_Loader_Poll();
+        if (loader_status != LOADER_IDLE) {
+            SetDutyCyclePWM1(0);
+            SetDutyCyclePWM2(0);
+            ctx->state = STOPPED;
+            return;
+        }
+#endif
+        if (Tick_Elapsed(start) >= TICKS_PER_SECOND) {
+            start += TICKS_PER_SECOND;
+            seconds--;
+        }
+        Tick_Idle();
+    }
+}
+
 //----------------------------------------------------------------------------
 // exec_seq : execute a command sequence 
 // ========
-void exec_seq(uint8_t seq_start_no)
+//
+// Notes
+//    All the sequence state is in the context 'ctx' (see seq.h).  The
+//    program is read from the RAM cache 'seq_program[]' (see seq_load.c).
+//
+void exec_seq(SEQ_CONTEXT *ctx, uint8_t seq_start_no)
 {
 uint16_t      temp1, temp2;
-uint8_t       seq_counter;
-SEQ_STATE   state;
+int           count;
+uint8_t       depth;
+#ifdef SEQ_PROFILE
+COMMAND     command;
+#endif
 
-    seq_counter = seq_start_no;
-    state = RUNNING;
+    ctx->seq_counter = seq_start_no;
+    ctx->call_depth = 0;
+    ctx->loop_depth = 0;
+    ctx->state = RUNNING;
     
     for (;;) {
-        switch (sequence[seq_counter].cmd) {
+#ifdef ODOMETRY
+        Odometry_Update();
+#endif
+#ifdef TELEMETRY
+        Telemetry_Poll(ctx);
+#endif
+        if (ctx->seq_counter >= seq_program_lines) {
+            SetDutyCyclePWM1(0);                // ran off the end of the program
+            SetDutyCyclePWM2(0);
+            ctx->state = STOPPED;
+            break;
+        }
+#ifdef RUN_LOG
+        Run_Log_Line(ctx->seq_counter, seq_program[ctx->seq_counter].cmd);
+#endif
+#ifdef SEQ_PROFILE
+        command = seq_program[ctx->seq_counter].cmd;
+        Profile_Start();
+#endif
+        switch (seq_program[ctx->seq_counter].cmd) {
             case FINISH :
                 SetDutyCyclePWM1(0);
                 SetDutyCyclePWM2(0);
-                state = STOPPED;
+                ctx->state = STOPPED;
                 break;
+            case SETGO :
+            case SETSPEED :
+                if (seq_program[ctx->seq_counter].param1 == IMMEDIATE) {
+                    ctx->right_speed = seq_program[ctx->seq_counter].param2;    // % of full speed
+                    ctx->left_speed = seq_program[ctx->seq_counter].param3;   // % of full speed
+                } 
+                else {  // must be REGISTER mode
+                    ctx->right_speed = ctx->vars[seq_program[ctx->seq_counter].param2];
+                    ctx->left_speed = ctx->vars[seq_program[ctx->seq_counter].param3];
+                }
+                if (ctx->left_speed < 0 ) {
+                    ctx->left_direction = BACKWARD;
+                    ctx->left_speed  = (FULL_PWM * ctx->left_speed * -1) - ctx->left_offset;
+                } 
+                else {
+                    ctx->left_direction = FORWARD;
+                    ctx->left_speed  = (FULL_PWM * ctx->left_speed) - ctx->left_offset;
+                } 
+                                       
+                if (ctx->right_speed < 0 ) {
+                    ctx->right_direction = BACKWARD;
+                    ctx->right_speed  = (FULL_PWM * ctx->right_speed * -1) - ctx->right_offset;
+                } 
+                else {
+                    ctx->right_direction = FORWARD;
+                    ctx->right_speed  = (FULL_PWM * ctx->right_speed) - ctx->right_offset;
+                } 
+#ifdef RUN_LOG
+                Run_Log_Speed((ctx->right_direction == BACKWARD) ? -ctx->right_speed : ctx->right_speed,
+                              (ctx->left_direction == BACKWARD) ? -ctx->left_speed : ctx->left_speed);
+#endif
+                ctx->seq_counter++;
+                if (seq_program[ctx->seq_counter - 1].cmd == SETSPEED) {
+                    break;
+                }
+                // SETGO : fall through to the START on the next line
             case START :
-                if (left_direction == FORWARD) {
+                if (ctx->left_direction == FORWARD) {
                     LEFT_MOTOR_DIR = SET_FORWARD;
                 } else {
                     LEFT_MOTOR_DIR = SET_REVERSE;
                 }
-                SetDutyCyclePWM2(left_speed);
-                if (right_direction == FORWARD) {
+                SetDutyCyclePWM2(Battery_Compensate(ctx->left_speed));
+                if (ctx->right_direction == FORWARD) {
                     RIGHT_MOTOR_DIR = SET_FORWARD;
                 } else {
                     RIGHT_MOTOR_DIR = SET_REVERSE;
                 }
-                SetDutyCyclePWM1(right_speed);
-                seq_counter++;
+                SetDutyCyclePWM1(Battery_Compensate(ctx->right_speed));
+                ctx->seq_counter++;
                 break;
 
             case STOP :
                 SetDutyCyclePWM1(0);
                 SetDutyCyclePWM2(0);
-                seq_counter++;
+                ctx->seq_counter++;
                 break;
 
             case WAIT :
-                DelayS(sequence[seq_counter].param1);
-                seq_counter++;
+                seq_wait(ctx, seq_program[ctx->seq_counter].param1);
+                ctx->seq_counter++;
                 break;
 
-            case SETSPEED :
-                if (sequence[seq_counter].param1 == IMMEDIATE) {
-                    right_speed = sequence[seq_counter].param2;    // % of full speed
-                    left_speed = sequence[seq_counter].param3;   // % of full speed
-                } 
-                else {  // must be REGISTER mode
-                    right_speed = vars[sequence[seq_counter].param2];
-                    left_speed = vars[sequence[seq_counter].param3];
+            case SETVAR :
+                ctx->vars[seq_program[ctx->seq_counter].param1] = seq_program[ctx->seq_counter].param2;
+                ctx->seq_counter++;
+                break;
+
+            case JUMP :
+                ctx->seq_counter = seq_program[ctx->seq_counter].param1;
+                break;
+
+            case CALL :
+                if (ctx->call_depth >= SEQ_CALL_DEPTH) {
+                    SetDutyCyclePWM1(0);        // too deep : abandon the sequence
+                    SetDutyCyclePWM2(0);
+                    ctx->state = STOPPED;
+                    break;
                 }
-                if (left_speed < 0 ) {
-                    left_direction = BACKWARD;
-                    left_speed  = (FULL_PWM * left_speed * -1) - left_offset;
-                } 
-                else {
-                    left_direction = FORWARD;
-                    left_speed  = (FULL_PWM * left_speed) - left_offset;
-                } 
-                                       
-                if (right_speed < 0 ) {
-                    right_direction = BACKWARD;
-                    right_speed  = (FULL_PWM * right_speed * -1) - right_offset;
-                } 
-                else {
-                    right_direction = FORWARD;
-                    right_speed  = (FULL_PWM * right_speed) - right_offset;
-                } 
-                seq_counter++;
+                ctx->call_stack[ctx->call_depth++] = ctx->seq_counter + 1;
+                ctx->seq_counter = seq_program[ctx->seq_counter].param1;
                 break;
 
-            case SETVAR :
-                vars[sequence[seq_counter].param1] = sequence[seq_counter].param2;
-                seq_counter++;
+            case RETURN :
+                if (ctx->call_depth == 0) {
+                    SetDutyCyclePWM1(0);        // no CALL to return to
+                    SetDutyCyclePWM2(0);
+                    ctx->state = STOPPED;
+                    break;
+                }
+                ctx->seq_counter = ctx->call_stack[--ctx->call_depth];
                 break;
 
-            case JUMP :
-                seq_counter = sequence[seq_counter].param1;
+            case REPEAT :
+                if (seq_program[ctx->seq_counter].param1 == IMMEDIATE) {
+                    count = seq_program[ctx->seq_counter].param2;
+                }
+                else {  // must be REGISTER mode
+                    count = ctx->vars[seq_program[ctx->seq_counter].param2];
+                }
+                if (count <= 0) {               // skip to the line after the matching END
+                    depth = 1;
+                    while ((depth != 0) && (++ctx->seq_counter < seq_program_lines)) {
+                        if (seq_program[ctx->seq_counter].cmd == REPEAT) {
+                            depth++;
+                        }
+                        else if (seq_program[ctx->seq_counter].cmd == END) {
+                            depth--;
+                        }
+                    }
+                    ctx->seq_counter++;
+                    break;
+                }
+                if (ctx->loop_depth >= SEQ_LOOP_DEPTH) {
+                    SetDutyCyclePWM1(0);        // too deep : abandon the sequence
+                    SetDutyCyclePWM2(0);
+                    ctx->state = STOPPED;
+                    break;
+                }
+                ctx->seq_counter++;
+                ctx->loop_start[ctx->loop_depth] = ctx->seq_counter;
+                ctx->loop_count[ctx->loop_depth] = count;
+                ctx->loop_depth++;
+                break;
+
+            case END :
+                if (ctx->loop_depth == 0) {
+                    SetDutyCyclePWM1(0);        // no REPEAT to end
+                    SetDutyCyclePWM2(0);
+                    ctx->state = STOPPED;
+                    break;
+                }
+                if (--ctx->loop_count[ctx->loop_depth - 1] != 0) {
+                    ctx->seq_counter = ctx->loop_start[ctx->loop_depth - 1];
+                }
+                else {
+                    ctx->loop_depth--;
+                    ctx->seq_counter++;
+                }
                 break;
 
             case LOAD_RAND :
-                temp1 = rand();
-                temp2 = (temp1 % (sequence[seq_counter].param3 - sequence[seq_counter].param2 + 1)) + sequence[seq_counter].param2;
-                vars[sequence[seq_counter].param1] = temp2;
-                seq_counter++;
+                temp1 = seq_rand(ctx);
+                temp2 = (temp1 % (seq_program[ctx->seq_counter].param3 - seq_program[ctx->seq_counter].param2 + 1)) + seq_program[ctx->seq_counter].param2;
+                ctx->vars[seq_program[ctx->seq_counter].param1] = temp2;
+                ctx->seq_counter++;
                 break;
 
             case DECSKIP :
-                vars[sequence[seq_counter].param1]--;
-                if (vars[sequence[seq_counter].param1] == 0) {
-                    seq_counter += 2;
+                ctx->vars[seq_program[ctx->seq_counter].param1]--;
+                if (ctx->vars[seq_program[ctx->seq_counter].param1] == 0) {
+                    ctx->seq_counter += 2;
                 } 
                 else {
-                    seq_counter++;
+                    ctx->seq_counter++;
                 }
                 break;
 
+            case DJNZ :
+                ctx->vars[seq_program[ctx->seq_counter].param1]--;
+                if (ctx->vars[seq_program[ctx->seq_counter].param1] == 0) {
+                    ctx->seq_counter += 2;
+                } 
+                else {
+                    ctx->seq_counter = seq_program[ctx->seq_counter].param2;
+                }
+                break;
+
+            case PRINT :
+                Display_Post(DISPLAY_STRING, seq_program[ctx->seq_counter].param2,
+                             seq_program[ctx->seq_counter].param3, seq_program[ctx->seq_counter].param1, 0);
+                ctx->seq_counter++;
+                break;
+
+            case SHOWVAR :
+                Display_Post(DISPLAY_NUMBER, seq_program[ctx->seq_counter].param2,
+                             seq_program[ctx->seq_counter].param3, ctx->vars[seq_program[ctx->seq_counter].param1], 0);
+                ctx->seq_counter++;
+                break;
+
+            case SHOWSPEED :
+                temp1 = (uint16_t)(ctx->right_speed + ctx->right_offset) / FULL_PWM;
+                temp2 = (uint16_t)(ctx->left_speed + ctx->left_offset) / FULL_PWM;
+                Display_Post(DISPLAY_SPEED, seq_program[ctx->seq_counter].param2, seq_program[ctx->seq_counter].param3,
+                             (ctx->right_direction == BACKWARD) ? -(int)temp1 : (int)temp1,
+                             (ctx->left_direction == BACKWARD) ? -(int)temp2 : (int)temp2);
+                ctx->seq_counter++;
+                break;
+
             case CALC :
-                switch (sequence[seq_counter].param1) {
+                switch (seq_program[ctx->seq_counter].param1) {
                     case ADD :
-                        vars[sequence[seq_counter].param2] += sequence[seq_counter].param3;
+                        ctx->vars[seq_program[ctx->seq_counter].param2] += seq_program[ctx->seq_counter].param3;
                         break;
                 }
-                seq_counter++;
+                ctx->seq_counter++;
+                break;
+
+            case EVENTSKIP :
+                if (seq_events & seq_program[ctx->seq_counter].param1) {
+                    INTCONbits.GIE = 0;
+                    seq_events &= ~seq_program[ctx->seq_counter].param1;
+                    INTCONbits.GIE = 1;
+                    ctx->seq_counter += 2;
+                }
+                else {
+                    ctx->seq_counter++;
+                }
+                break;
+
+            default :
+                SetDutyCyclePWM1(0);            // unknown or unimplemented opcode
+                SetDutyCyclePWM2(0);
+                ctx->state = STOPPED;
                 break;
 
         }  // end of outer switch
-        if (state == STOPPED) {
+#ifdef SEQ_PROFILE
+        Profile_Stop(command);
+#endif
+        if (ctx->state == STOPPED) {
             break;    // exit execute loop
         }
     }
@@ -448,7 +812,24 @@ void main (void)
 int speed_int, direction_int;
 
     init(); 
-    exec_seq(0);
+    exec_seq(&seq, 0);
     for(;;) {
+        I2C_Flush();
+        Display_Task();
+#ifdef RUN_LOG
+        Run_Log_Sync();
+#endif
+        Tick_Idle();
+#ifdef SEQ_LOADER
+        if (loader_status != LOADER_DONE) {
+            loader_status = Seq_Loader_Poll();
+        }
+        if (loader_status == LOADER_DONE) {
+            loader_status = LOADER_IDLE;
+            Seq_Load_Program(sequence, NOS_SEQUENCE_LINES);
+            Seq_Init(&seq);
+            exec_seq(&seq, 0);
+        }
+#endif
     }
 }
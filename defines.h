@@ -6,11 +6,40 @@
 
 
 #define     PIC_CLK      40000000 //MHz
+//
+// Build options
+//
+// #define     I2C_BENCHMARK           // measure I2C and display throughput at boot
+// #define     FMT_BENCHMARK           // compare the number formatter with the old division code at boot
+// #define     I2C_STATS               // per-device I2C counters and bus utilisation
+// #define     I2C_TRACE               // I2C event trace and TextLCD screen image (needs I2C_STATS)
+// #define     I2C_SIM                 // device models instead of the I2C bus (needs I2C_STATS)
+// #define     SEQ_PROFILE             // per-opcode dispatch counts and times
+// #define     SEQ_BENCHMARK           // run the reference sequences at boot (needs SEQ_PROFILE)
+// #define     BENCH_RECORD            // SEQ_BENCHMARK : store the results as this board's baselines
+// #define     ODOMETRY                // dead-reckoning position estimate
+// #define     TELEMETRY               // status records on the serial port
+// #define     SEQ_LOADER              // load sequence programs over the serial port (needs TELEMETRY)
+// #define     RUN_LOG                 // compressed run log in data EEPROM (18F4585, download needs SEQ_LOADER)
+//
+// Analogue inputs (PORTA) and their slots in the A/D scan list
+//
+#define     RIGHT_CURRENT_CHAN  0     // AN0 : right H-bridge current sense
+#define     LEFT_CURRENT_CHAN   1     // AN1 : left H-bridge current sense
+#define     IR_LEFT_CHAN        2     // AN2 : left IR distance sensor
+#define     IR_RIGHT_CHAN       3     // AN3 : right IR distance sensor
+#define     BATTERY_CHAN        4     // AN4 : battery voltage via divider
+
+#define     IR_LEFT_SLOT        0
+#define     IR_RIGHT_SLOT       1
+#define     BATTERY_SLOT        2
+#define     NOS_SCAN_SLOTS      3
 
 #include    "stdlib.h"
 #include    "stdio.h"
 #include    "types.h"
 #include    "delay.h"
+#include    "MCP23017.h"
 #include    "TextLCD.h"
 #include    "i2c_hw.h"
 #include    "adc_hw.h"
@@ -19,6 +48,25 @@
 #include    "delays.h"
 #include    "timers.h"
 #include    "pwm.h"
-#include    "MCP23017.h"
+#include    "Lcd03.h"
+#include    "ui_strings.h"
+#include    "bench.h"
+#include    "i2c_stats.h"
+#include    "i2c_sim.h"
+#include    "profile.h"
+#include    "interrupts.h"
+#include    "tick.h"
+#include    "motor.h"
+#include    "events.h"
+#include    "reflex.h"
+#include    "battery.h"
+#include    "seq.h"
+#include    "odometry.h"
+#include    "uart_hw.h"
+#include    "telemetry.h"
+#include    "eeprom.h"
+#include    "seq_load.h"
+#include    "display.h"
+#include    "runlog.h"
 
 #endif     //_DEFINES_H
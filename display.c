@@ -0,0 +1,119 @@
+//
+// display.c : queue of display updates for the TextLCD
+//
+// Writing to the TextLCD takes milliseconds per character (each nibble
+// is an I2C transfer plus the controller delays), far too long for the
+// sequence interpreter.  The interpreter posts small requests here
+// instead and Display_Task(), called from the wait and idle loops,
+// writes them to the display one at a time.
+//
+// A request for a screen position that already has one waiting replaces
+// it, so a value shown in a fast loop only costs the latest update.  The
+// queue is used only by the foreground and needs no protection.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// Global variables
+//
+uint8_t   display_dropped;
+
+//************************************************************************
+// Module variables
+//
+static DISPLAY_REQUEST   display_queue[DISPLAY_QUEUE_SIZE];
+static uint8_t           display_head;      // next free slot
+static uint8_t           display_tail;      // next request to be written
+
+//************************************************************************
+// Display_Init : empty the queue
+// ============
+//
+void Display_Init(void)
+{
+    display_head = 0;
+    display_tail = 0;
+    display_dropped = 0;
+}
+
+//************************************************************************
+// Display_Post : queue a display update
+// ============
+//
+// Description
+//    'value' and 'value2' are taken now, so the display shows them as
+//    they were when posted.  Returns 1 if queued (or merged with a
+//    waiting request for the same position), 0 if the queue was full.
+//
+uint8_t Display_Post(uint8_t type, uint8_t row, uint8_t column, int value, int value2)
+{
+uint8_t           i, head;
+DISPLAY_REQUEST   *request;
+
+    for (i = display_tail ; i != display_head ; i = (i + 1) & DISPLAY_QUEUE_MASK) {
+        request = &display_queue[i];
+        if ((request->row == row) && (request->column == column)) {
+            request->type = type;
+            request->value = value;
+            request->value2 = value2;
+            return 1;
+        }
+    }
+    head = (display_head + 1) & DISPLAY_QUEUE_MASK;
+    if (head == display_tail) {
+        display_dropped++;
+        return 0;
+    }
+    request = &display_queue[display_head];
+    request->type = type;
+    request->row = row;
+    request->column = column;
+    request->value = value;
+    request->value2 = value2;
+    display_head = head;
+    return 1;
+}
+
+//************************************************************************
+// Display_Task : write the oldest waiting request to the display
+// ============
+//
+// Notes
+//    Only one request is written per call, to bound the time taken out
+//    of the calling loop.  Requests off the screen are discarded.
+//
+void Display_Task(void)
+{
+DISPLAY_REQUEST   *request;
+char              number[8];
+
+    if (display_tail == display_head) {
+        return;
+    }
+    request = &display_queue[display_tail];
+    if ((request->row < LCD_ROWS) && (request->column < LCD_COLUMNS)) {
+        TextLCD_locate(request->row, request->column);
+        switch (request->type) {
+            case DISPLAY_STRING :
+                if ((uint16_t)request->value < NOS_UI_STRINGS) {
+                    TextLCD_putstring_rom(ui_strings[request->value]);
+                }
+                break;
+            case DISPLAY_NUMBER :
+                int16_to_asc_fmt(number, request->value, 6, 0);
+                TextLCD_putstring(number);
+                break;
+            case DISPLAY_SPEED :
+                TextLCD_putchar('R');
+                int16_to_asc_fmt(number, request->value, 4, FMT_PLUS);
+                TextLCD_putstring(number);
+                TextLCD_putstring_rom(" L");
+                int16_to_asc_fmt(number, request->value2, 4, FMT_PLUS);
+                TextLCD_putstring(number);
+                break;
+        }
+    }
+    display_tail = (display_tail + 1) & DISPLAY_QUEUE_MASK;
+}
@@ -0,0 +1,42 @@
+//
+// display.h : queue of display updates for the TextLCD
+//
+#ifndef _DISPLAY_H
+#define _DISPLAY_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+#define     DISPLAY_QUEUE_SIZE    8       // power of 2
+#define     DISPLAY_QUEUE_MASK   (DISPLAY_QUEUE_SIZE - 1)
+
+#define     DISPLAY_STRING        0       // ui_strings[value]
+#define     DISPLAY_NUMBER        1       // value, 6 characters
+#define     DISPLAY_SPEED         2       // "R+100 L-100" : value right, value2 left (%)
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+typedef struct {
+       uint8_t    type;
+       uint8_t    row, column;
+       int        value, value2;
+} DISPLAY_REQUEST;
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern uint8_t   display_dropped;           // requests lost with the queue full
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void     Display_Init(void);
+uint8_t  Display_Post(uint8_t type, uint8_t row, uint8_t column, int value, int value2);
+void     Display_Task(void);
+
+#endif //_DISPLAY_H
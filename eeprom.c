@@ -0,0 +1,59 @@
+//
+// eeprom.c : data EEPROM access
+//
+// A write takes about 4mS and is waited for, so writes are for the
+// foreground only and not while the sequence is timing a movement.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// EEPROM_Read : read a byte of data EEPROM
+// ===========
+//
+uint8_t EEPROM_Read(uint16_t address)
+{
+#if defined(__18F4585)
+    EEADRH = (uint8_t)(address >> 8);
+#endif
+    EEADR = (uint8_t)address;
+    EECON1bits.EEPGD = 0;
+    EECON1bits.CFGS = 0;
+    EECON1bits.RD = 1;
+    return (EEDATA);
+}
+
+//************************************************************************
+// EEPROM_Write : write a byte of data EEPROM
+// ============
+//
+// Notes
+//    The byte is not rewritten if it already holds the value, which saves
+//    both time and wear.  Interrupts are disabled only for the required
+//    0x55/0xAA unlock sequence, and GIE is then put back as it was, so
+//    a caller that has interrupts off keeps them off.
+//
+void EEPROM_Write(uint16_t address, uint8_t data)
+{
+uint8_t   gie;
+
+    if (EEPROM_Read(address) == data) {
+        return;
+    }
+    EEDATA = data;                    // EEADR was set by EEPROM_Read()
+    EECON1bits.EEPGD = 0;
+    EECON1bits.CFGS = 0;
+    EECON1bits.WREN = 1;
+    gie = INTCONbits.GIE;
+    INTCONbits.GIE = 0;
+    EECON2 = 0x55;
+    EECON2 = 0xAA;
+    EECON1bits.WR = 1;
+    INTCONbits.GIE = gie;
+    while (EECON1bits.WR) {
+        ;
+    }
+    EECON1bits.WREN = 0;
+    PIR2bits.EEIF = 0;
+}
@@ -0,0 +1,27 @@
+//
+// eeprom.h : data EEPROM access
+//
+#ifndef _EEPROM_H
+#define _EEPROM_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// Map :  sequence program store (seq_load.h), run log (runlog.h, 18F4585
+// only), benchmark baselines in the top BENCH_EE_SIZE bytes (bench.h)
+//
+#if defined(__18F4585)
+#define     EEPROM_SIZE         1024
+#else
+#define     EEPROM_SIZE          256
+#endif
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+uint8_t  EEPROM_Read(uint16_t address);
+void     EEPROM_Write(uint16_t address, uint8_t data);
+
+#endif //_EEPROM_H
@@ -0,0 +1,25 @@
+//
+// events.h : asynchronous events raised for the sequence interpreter
+//
+// Event bits are set at interrupt level and tested/cleared by the sequence
+// (EVENTSKIP).  Setting a single bit is one BSF instruction and so needs
+// no protection; clearing is done with interrupts disabled.
+//
+#ifndef _EVENTS_H
+#define _EVENTS_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+#define     EVENT_OBSTACLE      0x01      // obstacle reflex stopped the motors
+#define     EVENT_STALL         0x02      // stall protection stopped the motors
+#define     EVENT_LOW_BATTERY   0x04      // filtered battery voltage below LOW_BATTERY_LEVEL
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern volatile uint8_t  seq_events;
+
+#endif //_EVENTS_H
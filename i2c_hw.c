@@ -1,10 +1,20 @@
 //
 // i2c_hw.c : i2c access routines.
 //
+// Every wait on the bus is bounded by I2C_TIMEOUT_TICKS of the system
+// tick, so a missing or misbehaving device can delay the caller by a
+// known amount but never hang it.  See i2c_hw.h for the latency bound.
 //
 
 #include  "defines.h"
 
+//************************************************************************
+// Module variables
+//
+static uint8_t   i2c_sync_mode, i2c_slew;      // saved for bus recovery
+uint8_t          i2c_speed;                    // I2C_SPEED_100KHZ or I2C_SPEED_400KHZ
+static I2C_POST  i2c_posted[I2C_POST_SLOTS];   // pending posted writes
+
 //************************************************************************
 //************************************************************************
 // I2C_Open   Open I2C unit
@@ -12,6 +22,9 @@
 //
 void I2C_Open(uint8_t sync_mode, uint8_t slew )
 {
+  i2c_sync_mode = sync_mode;
+  i2c_slew = slew;
+
   SSPSTAT &= 0x3F;                // power on state 
   SSPCON1 = 0x00;                 // power on state
   SSPCON2 = 0x00;                 // power on state
@@ -24,41 +37,131 @@ void I2C_Open(uint8_t sync_mode, uint8_t slew )
   SSPCON1 |= SSPENB;              // enable synchronous serial port 
 }
 
+//************************************************************************
+// I2C_Set_Speed   Set bus clock and matching slew rate control
+// =============
+//
+// Notes
+//    Slew rate control is off (SMP = 1) for 100kHz and on for 400kHz, as
+//    required by the SSP module.  Call only while the bus is idle.
+//
+void I2C_Set_Speed(uint8_t speed)
+{
+    if (speed == I2C_SPEED_400KHZ) {
+        i2c_slew = SLEW_ON;
+        SSPADD = I2C_400KHZ;
+    } else {
+        speed = I2C_SPEED_100KHZ;
+        i2c_slew = SLEW_OFF;
+        SSPADD = I2C_100KHZ;
+    }
+    SSPSTAT = (SSPSTAT & 0x3F) | i2c_slew;
+    i2c_speed = speed;
+}
+
+//************************************************************************
+// I2C_Probe_Speed   Select 400kHz if every fitted device works at it
+// ===============
+//
+// Description
+//    Each device in the list has a register (or register block of up to
+//    4 bytes) whose contents do not change by themselves.  The register
+//    is read at 100kHz as a reference; a device that does not respond is
+//    taken as not fitted and skipped.  It is then read I2C_PROBE_READS
+//    times at 400kHz and every read must succeed and match.  If any
+//    device fails the bus is left at 100kHz.
+//
+// Returns the selected speed.
+//
+uint8_t I2C_Probe_Speed(const rom I2C_PROBE *devices, uint8_t nos_devices)
+{
+uint8_t   i, j, k;
+uint8_t   reference[4], value[4];
+uint8_t   count;
+
+    for (i=0 ; i < nos_devices ; i++) {
+        count = devices[i].count;
+        if (count > 4) {
+            count = 4;
+        }
+        I2C_Set_Speed(I2C_SPEED_100KHZ);
+        if (I2C_Read_Register(devices[i].address, devices[i].reg, reference, count) != I2C_OK) {
+            continue;
+        }
+        I2C_Set_Speed(I2C_SPEED_400KHZ);
+        for (j=0 ; j < I2C_PROBE_READS ; j++) {
+            if (I2C_Read_Register(devices[i].address, devices[i].reg, value, count) != I2C_OK) {
+                I2C_Set_Speed(I2C_SPEED_100KHZ);
+                return I2C_SPEED_100KHZ;
+            }
+            for (k=0 ; k < count ; k++) {
+                if (value[k] != reference[k]) {
+                    I2C_Set_Speed(I2C_SPEED_100KHZ);
+                    return I2C_SPEED_100KHZ;
+                }
+            }
+        }
+    }
+    I2C_Set_Speed(I2C_SPEED_400KHZ);
+    return I2C_SPEED_400KHZ;
+}
+
 //************************************************************************
 // I2C_Write   Write a single byte
 // =========
 //
 uint8_t I2C_Write( uint8_t data_out )
 {
+uint16_t  start;
+
   SSPBUF = data_out;                // write single byte to SSPBUF
     if ( SSPCON1bits.WCOL ) {       // test if write collision occurred
-        return ( -1 );              // if WCOL bit is set return negative #
-    } else {
-        while( SSPSTATbits.BF )     // wait until write cycle is complete  
-            ;       
-        return ( 0 );               // if WCOL bit is not set return non-negative #
+        SSPCON1bits.WCOL = 0;
+        return ( I2C_ERR_COLLISION );
+    }
+    start = Tick_Get();
+    while( SSPSTATbits.BF ) {       // wait until write cycle is complete  
+        if (Tick_Elapsed(start) >= I2C_TIMEOUT_TICKS) {
+            return ( I2C_ERR_TIMEOUT );
+        }
     }
+    return ( I2C_OK );
 }
 
 //************************************************************************
 // I2C_Read   Read a single byte
 // ========
 //
-uint8_t I2C_Read( void )
+uint8_t I2C_Read( uint8_t *data_in )
 {
+uint16_t  start;
+
   SSPCON2bits.RCEN = 1;           // enable master for 1 byte reception
-  while ( !SSPSTATbits.BF );      // wait until byte received  
-  return ( SSPBUF );              // return with read byte 
+  start = Tick_Get();
+  while ( !SSPSTATbits.BF ) {     // wait until byte received  
+      if (Tick_Elapsed(start) >= I2C_TIMEOUT_TICKS) {
+          return ( I2C_ERR_TIMEOUT );
+      }
+  }
+  *data_in = SSPBUF;              // read byte 
+  return ( I2C_OK );
 }
 
 //************************************************************************
 // I2C_Idle   Test and wait until I2C module is idle
 // =======
 //
-void I2C_Idle( void )
+uint8_t I2C_Idle( void )
 {
-  while ( ( SSPCON2 & 0x1F ) | ( SSPSTATbits.R_W ) )
-     continue;
+uint16_t  start;
+
+  start = Tick_Get();
+  while ( ( SSPCON2 & 0x1F ) | ( SSPSTATbits.R_W ) ) {
+      if (Tick_Elapsed(start) >= I2C_TIMEOUT_TICKS) {
+          return ( I2C_ERR_TIMEOUT );
+      }
+  }
+  return ( I2C_OK );
 }
 
 //************************************************************************
@@ -109,76 +212,434 @@ void I2C_Ack(void)
 }
 
 //************************************************************************
-// exec_command : execute an I2C cmmand
+// I2C_Bus_Recover : clear a stuck bus
+// ===============
+//
+// Description
+//    A slave that lost clocks part way through a byte can hold SDA low
+//    indefinitely.  The SSP module is disabled, up to 9 clocks are
+//    generated on SCL until the slave releases SDA, then a stop condition
+//    is generated by hand and the module is re-opened.  The pins are
+//    driven open-drain style by switching their TRIS bits with the port
+//    latch held at 0.
+//
+void I2C_Bus_Recover(void)
+{
+uint8_t  i;
+
+    SSPCON1bits.SSPEN = 0;
+    LATCbits.LATC3 = 0;
+    LATCbits.LATC4 = 0;
+    DDRCbits.RC4 = 1;                 // release SDA
+    DDRCbits.RC3 = 1;                 // release SCL
+    DelayUs(5);
+    for (i=0 ; i < 9 ; i++) {
+        if (PORTCbits.RC4) {          // SDA released by slave
+            break;
+        }
+        DDRCbits.RC3 = 0;             // SCL low
+        DelayUs(5);
+        DDRCbits.RC3 = 1;             // SCL high
+        DelayUs(5);
+    }
+    DDRCbits.RC3 = 0;                 // stop : SDA low -> high with SCL high
+    DelayUs(5);
+    DDRCbits.RC4 = 0;
+    DelayUs(5);
+    DDRCbits.RC3 = 1;
+    DelayUs(5);
+    DDRCbits.RC4 = 1;
+    DelayUs(5);
+    I2C_Open(i2c_sync_mode, i2c_slew);
+}
+
+//************************************************************************
+// I2C_Put : write a byte and check the acknowledge
+// =======
+//
+static uint8_t I2C_Put(uint8_t data)
+{
+uint8_t  status;
+
+    status = I2C_Write(data);
+    if (status == I2C_OK) {
+        status = I2C_Idle();
+    }
+    if ((status == I2C_OK) && SSPCON2bits.ACKSTAT) {
+        status = I2C_ERR_NACK;
+    }
+    return status;
+}
+
+//************************************************************************
+// I2C_Get : read a byte and send ACK (more to follow) or NACK (last byte)
+// =======
+//
+static uint8_t I2C_Get(uint8_t *data, uint8_t last)
+{
+uint8_t  status;
+
+    status = I2C_Read(data);
+    if (status == I2C_OK) {
+        status = I2C_Idle();
+    }
+    if (status != I2C_OK) {
+        return status;
+    }
+    if (last) {
+        I2C_NotAck();
+    } else {
+        I2C_Ack();
+    }
+    return I2C_Idle();
+}
+
+//************************************************************************
+// I2C_Transfer : execute an I2C transfer described by a descriptor
 // ============
 //
 // Description
-//    General purpose I2C communications routine.  An I2C_STRUCT structure
-//    provides all the necessary information for a write and optional read
-//    transfer.
+//    General purpose I2C communications routine.  The write phase sends
+//    the device address, the header bytes held in the descriptor, then
+//    'payload_count' bytes taken directly from the caller's RAM buffer or,
+//    if 'payload_rom' is set, from program memory.  An optional read phase
+//    (MODE_RESTART or MODE_STOP_START) reads 'reply_count' bytes directly
+//    into the caller's buffer.  Nothing is copied, so payload and reply
+//    lengths are limited only by the 8-bit counts.
 //
-void exec_command(I2C_STRUCT *command, uint8_t mode)
+uint8_t I2C_Transfer(I2C_XFER *xfer)
 {
-uint8_t i, count, address;
+uint8_t             i, count, address, status;
+const uint8_t       *pt;
+const rom uint8_t   *rom_pt;
+#ifdef I2C_STATS
+uint16_t            start;
 
-	address = ((command->cmd[0] << 1) & I2C_READ_MASK);
-	command->cmd[0] = address;
+    start = I2C_Stats_Time();
+#endif
+#ifdef I2C_SIM
+    status = I2C_Sim_Transfer(xfer);        // device models instead of the bus
+    xfer->status = status;
+    I2C_Stats_Record(xfer, start);
+#ifdef RUN_LOG
+    if (status != I2C_OK) {
+        Run_Log_I2C(xfer->address, status);
+    }
+#endif
+    return status;
+#endif
+	address = ((xfer->address << 1) & I2C_READ_MASK);
 //
 // write byte stream
 //
-    I2C_Idle();
+    status = I2C_Idle();
+    if (status != I2C_OK) {
+        goto failed;
+    }
     I2C_Start();
-    I2C_Idle();
-    for (i=0 ; i<command->send_count ; i++) {
-        I2C_Write(command->cmd[i]);
-        while(SSPCON2bits.ACKSTAT)
-            ;
-        I2C_Idle();
+    status = I2C_Idle();
+    if (status != I2C_OK) {
+        goto failed;
+    }
+    status = I2C_Put(address);
+    if (status != I2C_OK) {
+        goto failed;
+    }
+    for (i=0 ; i < xfer->header_count ; i++) {
+        status = I2C_Put(xfer->header[i]);
+        if (status != I2C_OK) {
+            goto failed;
+        }
+    }
+    count = xfer->payload_count;
+    if (xfer->payload_rom != 0) {
+        rom_pt = xfer->payload_rom;
+        while (count != 0) {
+            status = I2C_Put(*rom_pt++);
+            if (status != I2C_OK) {
+                goto failed;
+            }
+            count--;
+        }
+    } else {
+        pt = xfer->payload;
+        while (count != 0) {
+            status = I2C_Put(*pt++);
+            if (status != I2C_OK) {
+                goto failed;
+            }
+            count--;
+        }
     }
 //
-// if there is no requirement to read any data then just return.
+// if there is no requirement to read any data then just finish.
 //
-	if (mode == WRITE_ONLY) {
-    	I2C_Stop();
-    	I2C_Idle();
-		return;
-	}
+	if ((xfer->mode != WRITE_ONLY) && (xfer->reply_count != 0)) {
 //
 // restart or fresh stop/start
 //
-    if (mode == MODE_RESTART) {
-        I2C_Restart();
-        I2C_Idle();
-    } else {                        // must be MODE_STOP_START
-        I2C_Stop();
-        I2C_Idle();
-        DelayUs(10);
-        if (command->delay != 0) {
-            DelayBigMs(command->delay);
+        if (xfer->mode == MODE_RESTART) {
+            I2C_Restart();
+            status = I2C_Idle();
+            if (status != I2C_OK) {
+                goto failed;
+            }
+        } else {                        // must be MODE_STOP_START
+            I2C_Stop();
+            status = I2C_Idle();
+            if (status != I2C_OK) {
+                goto failed;
+            }
+            DelayUs(10);
+            if (xfer->delay != 0) {
+                DelayBigMs(xfer->delay);
+            }
+            I2C_Start();
+            status = I2C_Idle();
+            if (status != I2C_OK) {
+                goto failed;
+            }
         }
-        I2C_Start();
-        I2C_Idle();
-    }
 //
 // read byte stream
 //	
-    I2C_Write(command->cmd[0] | I2C_WRITE_MASK);
-    while(SSPCON2bits.ACKSTAT)
-        ;
-    I2C_Idle();
-    count = command->get_count - 1;
-    for (i=0 ; i < count ; i++) {
-            command->reply[i] = I2C_Read(); 
-            I2C_Idle();
-            I2C_Ack();
-            I2C_Idle();
-    }
-    command->reply[command->get_count-1] = I2C_Read(); 
-    I2C_Idle();
-    I2C_NotAck();
-    I2C_Idle();
+        status = I2C_Put(address | I2C_WRITE_MASK);
+        if (status != I2C_OK) {
+            goto failed;
+        }
+        count = xfer->reply_count - 1;
+        for (i=0 ; i <= count ; i++) {
+            status = I2C_Get(&xfer->reply[i], (i == count));
+            if (status != I2C_OK) {
+                goto failed;
+            }
+        }
+    }
     I2C_Stop();
-    I2C_Idle();
-    return;
+    status = I2C_Idle();
+    if (status != I2C_OK) {
+        goto failed;
+    }
+    xfer->status = I2C_OK;
+#ifdef I2C_STATS
+    I2C_Stats_Record(xfer, start);
+#endif
+    return I2C_OK;
+//
+// A NACK leaves the bus usable, so a stop is enough.  A timeout or
+// collision (or a stop that does not complete) means the bus may be held
+// by a slave and it is cleared with I2C_Bus_Recover().
+//
+failed:
+    xfer->status = status;
+    if (status == I2C_ERR_NACK) {
+        I2C_Stop();
+        if (I2C_Idle() != I2C_OK) {
+            I2C_Bus_Recover();
+        }
+    } else {
+        I2C_Bus_Recover();
+    }
+#ifdef I2C_STATS
+    I2C_Stats_Record(xfer, start);
+#endif
+#ifdef RUN_LOG
+    Run_Log_I2C(xfer->address, status);
+#endif
+    return status;
 }
 
+//************************************************************************
+// I2C_Write_Register : write a block of bytes starting at a device register
+// ==================
+//
+uint8_t I2C_Write_Register(uint8_t address, uint8_t reg, const uint8_t *data, uint8_t count)
+{
+I2C_XFER   xfer;
+
+    xfer.address = address;
+    xfer.header[0] = reg;
+    xfer.header_count = 1;
+    xfer.payload = data;
+    xfer.payload_rom = 0;
+    xfer.payload_count = count;
+    xfer.reply_count = 0;
+    xfer.delay = 0;
+    xfer.mode = WRITE_ONLY;
+    return I2C_Transfer(&xfer);
+}
+
+//************************************************************************
+// I2C_Read_Register : read a block of bytes starting at a device register
+// =================
+//
+uint8_t I2C_Read_Register(uint8_t address, uint8_t reg, uint8_t *reply, uint8_t count)
+{
+I2C_XFER   xfer;
+
+    I2C_Flush_Device(address);       // read back what has been written
+    xfer.address = address;
+    xfer.header[0] = reg;
+    xfer.header_count = 1;
+    xfer.payload = 0;
+    xfer.payload_rom = 0;
+    xfer.payload_count = 0;
+    xfer.reply = reply;
+    xfer.reply_count = count;
+    xfer.delay = 0;
+    xfer.mode = MODE_RESTART;
+    return I2C_Transfer(&xfer);
+}
+
+//************************************************************************
+// I2C_Post_Register : queue a register write for write-combining
+// =================
+//
+// Description
+//    A posted write (flags = I2C_POSTED) is copied into the posted table.
+//    If a write of the same registers of the device is already pending its
+//    data is overwritten (last writer wins).  If a pending write only
+//    overlaps it (a different start register or length), the device's
+//    pending writes are sent first, since the table is flushed in slot
+//    order and not in the order the writes were posted.  Otherwise a free
+//    slot is used; if the table is full it is flushed first.
+//
+//    An ordered write (flags = I2C_ORDERED) drops any pending write of the
+//    device that it covers completely (a pending write that also sets
+//    other registers is kept), flushes the rest of the device's pending
+//    writes so they reach the device first, then is sent at once.
+//
+// Notes
+//    Only use posted writes where a missed intermediate value does not
+//    matter, e.g. LEDs and the backlight.  Strobes such as the LCD enable
+//    line must be ordered.  Posted writes report errors from I2C_Flush().
+//    Writes are combined only when they start at the same register and
+//    have the same length, so the pending writes of a device never overlap.
+//
+uint8_t I2C_Post_Register(uint8_t address, uint8_t reg, const uint8_t *data, uint8_t count, uint8_t flags)
+{
+uint8_t   i, slot;
+
+    slot = I2C_POST_SLOTS;
+    for (i=0 ; i < I2C_POST_SLOTS ; i++) {
+        if ((i2c_posted[i].count == 0) || (i2c_posted[i].address != address) ||
+            (i2c_posted[i].reg >= (reg + count)) || (reg >= (i2c_posted[i].reg + i2c_posted[i].count))) {
+            continue;                       // no registers in common
+        }
+        if (flags & I2C_ORDERED) {
+            if ((i2c_posted[i].reg >= reg) &&
+                ((i2c_posted[i].reg + i2c_posted[i].count) <= (reg + count))) {
+                i2c_posted[i].count = 0;    // fully overwritten : not needed
+            }
+        } else if ((i2c_posted[i].reg == reg) && (i2c_posted[i].count == count)) {
+            slot = i;
+            break;
+        } else {
+            I2C_Flush_Device(address);      // send the older write first
+            break;
+        }
+    }
+    if ((flags & I2C_ORDERED) || (count > I2C_POST_MAX_BYTES)) {
+        I2C_Flush_Device(address);
+        return I2C_Write_Register(address, reg, data, count);
+    }
+    if (slot == I2C_POST_SLOTS) {
+        for (i=0 ; i < I2C_POST_SLOTS ; i++) {
+            if (i2c_posted[i].count == 0) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot == I2C_POST_SLOTS) {
+            I2C_Flush();
+            slot = 0;
+        }
+        i2c_posted[slot].address = address;
+        i2c_posted[slot].reg = reg;
+        i2c_posted[slot].count = count;
+    }
+    for (i=0 ; i < count ; i++) {
+        i2c_posted[slot].data[i] = data[i];
+    }
+    return I2C_OK;
+}
+
+//************************************************************************
+// I2C_Flush_Device : send the pending posted writes for one device
+// ================
+//
+// Description
+//    Returns I2C_OK, or the first error.  A write that fails is dropped.
+//
+uint8_t I2C_Flush_Device(uint8_t address)
+{
+uint8_t   i, status, result;
+
+    result = I2C_OK;
+    for (i=0 ; i < I2C_POST_SLOTS ; i++) {
+        if ((i2c_posted[i].count != 0) && (i2c_posted[i].address == address)) {
+            status = I2C_Write_Register(address, i2c_posted[i].reg, i2c_posted[i].data, i2c_posted[i].count);
+            i2c_posted[i].count = 0;
+            if (result == I2C_OK) {
+                result = status;
+            }
+        }
+    }
+    return result;
+}
+
+//************************************************************************
+// I2C_Flush : send all pending posted writes
+// =========
+//
+// Notes
+//    Called from the foreground idle points (the sequence wait loop and
+//    the idle loop in main()), so posted writes reach the devices within
+//    one pass of the loop.
+//
+uint8_t I2C_Flush(void)
+{
+uint8_t   i, status, result;
+
+    result = I2C_OK;
+    for (i=0 ; i < I2C_POST_SLOTS ; i++) {
+        if (i2c_posted[i].count != 0) {
+            status = I2C_Write_Register(i2c_posted[i].address, i2c_posted[i].reg, i2c_posted[i].data, i2c_posted[i].count);
+            i2c_posted[i].count = 0;
+            if (result == I2C_OK) {
+                result = status;
+            }
+        }
+    }
+    return result;
+}
+
+//************************************************************************
+// exec_command : execute an I2C cmmand
+// ============
+//
+// Description
+//    Compatibility wrapper for drivers that build a complete I2C_STRUCT.
+//    cmd[0] holds the 7-bit device address, and the remaining bytes are
+//    sent as the payload.  A command with no address byte (send_count of
+//    0) is refused with I2C_ERR_PARAM.
+//
+void exec_command(I2C_STRUCT *command, uint8_t mode)
+{
+I2C_XFER   xfer;
+
+    if (command->send_count == 0) {
+        command->status = I2C_ERR_PARAM;
+        return;
+    }
+    xfer.address = command->cmd[0];
+    xfer.header_count = 0;
+    xfer.payload = &command->cmd[1];
+    xfer.payload_rom = 0;
+    xfer.payload_count = command->send_count - 1;
+    xfer.reply = command->reply;
+    xfer.reply_count = command->get_count;
+    xfer.delay = (uint16_t)command->delay;
+    xfer.mode = mode;
+    command->status = I2C_Transfer(&xfer);
+}
@@ -18,12 +18,46 @@ typedef struct {
        uint32_t delay;                // delay in mS between command write and data read
        uint8_t  status;               // error code or OK
 } I2C_STRUCT;
+//
+// descriptor for a scatter/gather transfer : the bytes sent are the
+// header followed by the payload (from RAM or from program memory), and
+// the reply is read directly into the caller's buffer.
+//
+#define      I2C_MAX_HEADER    4
+
+typedef struct {
+       uint8_t            address;                 // 7-bit device address
+       uint8_t            header[I2C_MAX_HEADER];  // register/command bytes
+       uint8_t            header_count;
+       const uint8_t      *payload;                // RAM payload, or
+       const rom uint8_t  *payload_rom;            // program memory payload (used if not 0)
+       uint8_t            payload_count;
+       uint8_t            *reply;                  // buffer for bytes read
+       uint8_t            reply_count;
+       uint16_t           delay;                   // mS between write and read (MODE_STOP_START)
+       uint8_t            mode;                    // WRITE_ONLY, MODE_RESTART or MODE_STOP_START
+       uint8_t            status;                  // I2C_OK or error code
+} I2C_XFER;
+
+//
+// entry in the list of devices checked by I2C_Probe_Speed()
+//
+typedef struct {
+       uint8_t  address;              // 7-bit device address
+       uint8_t  reg;                  // register that holds a steady value
+       uint8_t  count;                // number of bytes to compare (1 -> 4)
+} I2C_PROBE;
 
 //
-// I2C baud rate generator constants
+// I2C baud rate generator constants : SSPADD = Fosc/(4 * rate) - 1
 //
-#define     I2C_100KHZ          0x62
-#define     I2C_400KHZ          0x0E
+#define     I2C_100KHZ          0x62      // ~101kHz at 40MHz
+#define     I2C_400KHZ          0x18      //  400kHz at 40MHz
+
+#define     I2C_SPEED_100KHZ    0
+#define     I2C_SPEED_400KHZ    1
+
+#define     I2C_PROBE_READS     8         // reads per device at 400kHz
 //
 //  I2C SSPCON1 REGISTER
 //
@@ -43,24 +77,66 @@ typedef struct {
 #define     MODE_RESTART          0x0C
 #define     WRITE_ONLY            0x30
 
+#define     I2C_OK                 0x00
+#define     I2C_ERR_NACK           0x01      // address or data byte not acknowledged
+#define     I2C_ERR_TIMEOUT        0x02      // bus wait exceeded I2C_TIMEOUT_TICKS
+#define     I2C_ERR_COLLISION      0x03      // write collision
+#define     I2C_ERR_PARAM          0x04      // bad transfer description : nothing sent
+//
+// Bus waits are bounded by the system tick.  A wait is abandoned after
+// between 1 and 2 mS, so a failing transaction takes at most its normal
+// duration plus 2mS, plus ~0.2mS for bus recovery.
+//
+#define     I2C_TIMEOUT_TICKS      2
+
 #define     I2C_READ_MASK          0xFE
 #define     I2C_WRITE_MASK         0x01
 
+//
+// Posted (write-combining) register writes.  A posted write is held until
+// I2C_Flush() and is replaced by any later write to the same device
+// register, so only the last value goes onto the bus.  An ordered write
+// first sends everything pending for its device, then goes out at once.
+//
+#define     I2C_POST_SLOTS         8         // pending (address, register) writes : one per expander
+#define     I2C_POST_MAX_BYTES     2         // largest posted write (register pair)
+
+#define     I2C_POSTED             0x00
+#define     I2C_ORDERED            0x01
+
+typedef struct {
+       uint8_t  address;                       // 7-bit device address
+       uint8_t  reg;                           // first register written
+       uint8_t  count;                         // bytes pending (0 = slot free)
+       uint8_t  data[I2C_POST_MAX_BYTES];
+} I2C_POST;
+
+extern uint8_t   i2c_speed;
+
 //************************************************************************
 // Function prototypes
 //
 void   I2C_Open( uint8_t sync_mode, uint8_t slew );
+void   I2C_Set_Speed(uint8_t speed);
+uint8_t  I2C_Probe_Speed(const rom I2C_PROBE *devices, uint8_t nos_devices);
 uint8_t  I2C_Write( uint8_t data_out );
-uint8_t  I2C_Read( void );
-void   I2C_Idle(void);
+uint8_t  I2C_Read( uint8_t *data_in );
+uint8_t  I2C_Idle(void);
 void   I2C_Stop(void);
 void   I2C_Start(void);
 void   I2C_Restart(void);
 void   I2C_Start(void);
 void   I2C_NotAck(void);
 void   I2C_Ack(void);
+void   I2C_Bus_Recover(void);
 
 void   exec_command(I2C_STRUCT *command, uint8_t mode);
+uint8_t  I2C_Transfer(I2C_XFER *xfer);
+uint8_t  I2C_Write_Register(uint8_t address, uint8_t reg, const uint8_t *data, uint8_t count);
+uint8_t  I2C_Read_Register(uint8_t address, uint8_t reg, uint8_t *reply, uint8_t count);
+uint8_t  I2C_Post_Register(uint8_t address, uint8_t reg, const uint8_t *data, uint8_t count, uint8_t flags);
+uint8_t  I2C_Flush_Device(uint8_t address);
+uint8_t  I2C_Flush(void);
 
 
 #endif //_I2C_HW_H
@@ -0,0 +1,608 @@
+//
+// i2c_sim.c : behavioural models of the I2C devices
+//
+// Built in when I2C_SIM is defined in defines.h.  I2C_Transfer() passes
+// each transfer to I2C_Sim_Transfer() instead of driving the SSP, and it
+// is answered by a model of the device at that address :
+//
+//    MCP23017_ADDRESS   MCP23017 expander, with IOCON.BANK and SEQOP
+//                       address pointer behaviour.  Port A drives an
+//                       HD44780 in 4-bit mode as wired on the breakout
+//                       board (see TextLCD.h), with its busy times.
+//    LCD03_ADDRESS      LCD03 serial display : registers, command set
+//                       and 64 byte input buffer.
+//
+// Anything else does not acknowledge.  Every model records what it sees
+// in 'i2c_sim_events', stamped with the system tick and Timer1, and the
+// bus time the transfers would have taken is added up in
+// 'i2c_sim_stats'.  The decoded screens are in 'hd44780_screen' and
+// 'lcd03_screen', so a driver change can be checked in the simulator
+// against the expected display, event list and bus time.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+#ifdef I2C_SIM
+
+//************************************************************************
+// Global variables
+//
+I2C_SIM_STATS   i2c_sim_stats;
+I2C_SIM_EVENT   i2c_sim_events[I2C_SIM_EVENTS];
+uint16_t        i2c_sim_event_count;
+
+uint8_t         mcp_sim_regs[MCP_SIM_REGISTERS];
+uint16_t        mcp_sim_inputs;
+
+char            hd44780_screen[LCD_ROWS][LCD_COLUMNS];
+uint16_t        hd44780_busy_errors;
+
+char            lcd03_screen[LCD03_SIM_ROWS][LCD03_SIM_COLUMNS];
+uint16_t        lcd03_sim_keypad;
+uint8_t         lcd03_sim_backlight;
+
+//************************************************************************
+// Module variables
+//
+static uint8_t    mcp_pointer;            // register address pointer
+
+static uint8_t    hd_eight_bit;           // 1 until set to a 4-bit interface
+static uint8_t    hd_have_high;           // 4-bit mode : first nibble received
+static uint8_t    hd_high;
+static uint8_t    hd_address;             // DDRAM address
+static uint8_t    hd_increment;           // entry mode : 1 = cursor moves right
+static uint16_t   hd_busy_time;           // Timer1 count when the last operation started
+static uint16_t   hd_busy_tick;
+static uint16_t   hd_busy_counts;         // its execution time
+
+static uint8_t    lcd03_pointer;          // register read pointer
+static uint8_t    lcd03_row, lcd03_column;
+static uint8_t    lcd03_args;             // argument bytes still expected
+static uint8_t    lcd03_command;          // command that takes them
+static uint8_t    lcd03_arg;              // first argument
+static uint8_t    lcd03_tab;
+static uint8_t    lcd03_pending;          // bytes in the input buffer
+static uint16_t   lcd03_drain_time;       // Timer1 count of the last byte taken
+static uint16_t   lcd03_drain_tick;
+
+//************************************************************************
+// sim_event : record an event
+// =========
+//
+static void sim_event(uint8_t type, uint8_t reg, uint8_t value)
+{
+I2C_SIM_EVENT   *event;
+
+    event = &i2c_sim_events[i2c_sim_event_count & (I2C_SIM_EVENTS - 1)];
+    event->tick = Tick_Get();
+    event->time = I2C_Stats_Time();
+    event->type = type;
+    event->reg = reg;
+    event->value = value;
+    i2c_sim_event_count++;
+}
+
+//************************************************************************
+// sim_byte : byte 'n' of the write phase of a transfer
+// ========
+//
+static uint8_t sim_byte(I2C_XFER *xfer, uint8_t n)
+{
+    if (n < xfer->header_count) {
+        return xfer->header[n];
+    }
+    n -= xfer->header_count;
+    if (xfer->payload_rom != 0) {
+        return xfer->payload_rom[n];
+    }
+    return xfer->payload[n];
+}
+
+//************************************************************************
+// hd_advance : move the DDRAM address one place
+// ==========
+//
+// Notes
+//    Two line mode : row 0 is 0x00 -> 0x27 and row 1 is 0x40 -> 0x67, and
+//    the address runs on from the end of one row to the start of the other.
+//
+static void hd_advance(uint8_t right)
+{
+    if (right) {
+        if (hd_address == 0x27) {
+            hd_address = 0x40;
+        } else if (hd_address == 0x67) {
+            hd_address = 0x00;
+        } else {
+            hd_address++;
+        }
+    } else {
+        if (hd_address == 0x00) {
+            hd_address = 0x67;
+        } else if (hd_address == 0x40) {
+            hd_address = 0x27;
+        } else {
+            hd_address--;
+        }
+    }
+}
+
+//************************************************************************
+// hd_execute : run an instruction or store a character
+// ==========
+//
+static void hd_execute(uint8_t rs, uint8_t value)
+{
+uint8_t   row, column;
+
+    hd_busy_time = I2C_Stats_Time();
+    hd_busy_tick = Tick_Get();
+    hd_busy_counts = HD44780_FAST_COUNTS;
+    if (rs) {
+        sim_event(SIM_HD_DATA, hd_address, value);
+        row = (hd_address >= 0x40) ? 1 : 0;
+        column = hd_address - (row * 0x40);
+        if ((row < LCD_ROWS) && (column < LCD_COLUMNS)) {
+            hd44780_screen[row][column] = value;
+        }
+        hd_advance(hd_increment);
+        return;
+    }
+    sim_event(SIM_HD_COMMAND, 0, value);
+    if (value & CMD_SET_DDRAM_ADDRESS) {
+        hd_address = value & 0x7F;
+    } else if (value & CMD_SET_CGRAM_ADDRESS) {
+        ;                                   // user characters are not modelled
+    } else if (value & CMD_FUNCTION_SET) {
+        hd_eight_bit = ((value & INTERFACE_8_BIT) != 0);
+        hd_have_high = 0;
+    } else if (value & CMD_CURSOR_SHIFT) {
+        if ((value & 0x08) == 0) {          // cursor move, not display shift
+            hd_advance((value & SHIFT_CURSOR_RIGHT) != 0);
+        }
+    } else if (value & CMD_DISPLAY_CONTROL) {
+        ;
+    } else if (value & CMD_ENTRY_MODE) {
+        hd_increment = ((value & CURSOR_STEP_RIGHT) != 0);
+    } else if (value & CMD_RETURN_HOME) {
+        hd_address = 0;
+        hd_busy_counts = HD44780_SLOW_COUNTS;
+    } else if (value & CMD_CLEAR_DISPLAY) {
+        for (row=0 ; row < LCD_ROWS ; row++) {
+            for (column=0 ; column < LCD_COLUMNS ; column++) {
+                hd44780_screen[row][column] = ' ';
+            }
+        }
+        hd_address = 0;
+        hd_increment = 1;
+        hd_busy_counts = HD44780_SLOW_COUNTS;
+    }
+}
+
+//************************************************************************
+// hd_pins : follow the expander port A lines that drive the display
+// =======
+//
+// Notes
+//    Data is latched on the falling edge of E.  RW high (a read) is not
+//    modelled and the strobe is ignored.  A strobe before the previous
+//    operation has finished is counted in 'hd44780_busy_errors'.
+//
+static void hd_pins(uint8_t old_pins, uint8_t pins)
+{
+uint8_t   nibble, rs;
+
+    if (((old_pins & (1 << E_BIT)) == 0) || ((pins & (1 << E_BIT)) != 0) ||
+        ((pins & (1 << RW_BIT)) != 0)) {
+        return;
+    }
+    nibble = pins & 0x0F;
+    rs = ((pins & (1 << RS_BIT)) != 0);
+    if ((Tick_Elapsed(hd_busy_tick) <= 2) &&
+        ((uint16_t)(I2C_Stats_Time() - hd_busy_time) < hd_busy_counts)) {
+        hd44780_busy_errors++;
+        sim_event(SIM_HD_BUSY, 0, nibble);
+    }
+    if (hd_eight_bit) {
+        hd_execute(rs, nibble << 4);        // D3..D0 are not wired
+    } else if (hd_have_high == 0) {
+        hd_high = nibble;
+        hd_have_high = 1;
+    } else {
+        hd_have_high = 0;
+        hd_execute(rs, (hd_high << 4) | nibble);
+    }
+}
+
+//************************************************************************
+// mcp_index : register array index of a register address
+// =========
+//
+// Description
+//    Returns the index in 'mcp_sim_regs' (BANK = 0 order), or
+//    MCP_SIM_REGISTERS if the address is not a register.
+//
+static uint8_t mcp_index(uint8_t address)
+{
+    if ((mcp_sim_regs[IOCON] & MCP_IOCON_BANK) == 0) {
+        return ((address < MCP_SIM_REGISTERS) ? address : MCP_SIM_REGISTERS);
+    }
+    if ((address < 0x20) && ((address & 0x0F) <= 0x0A)) {     // BANK = 1 : port B at 0x10
+        return (((address & 0x0F) << 1) | (address >> 4));
+    }
+    return MCP_SIM_REGISTERS;
+}
+
+//************************************************************************
+// mcp_next : move the address pointer on after a byte
+// ========
+//
+// Notes
+//    SEQOP = 0 : sequential, wrapping at the end of the map.
+//    SEQOP = 1 : byte mode; with BANK = 0 the pointer toggles between the
+//    A and B registers of a pair, with BANK = 1 it stays where it is.
+//
+static void mcp_next(void)
+{
+uint8_t   iocon;
+
+    iocon = mcp_sim_regs[IOCON];
+    if (iocon & MCP_IOCON_SEQOP) {
+        if ((iocon & MCP_IOCON_BANK) == 0) {
+            mcp_pointer ^= 0x01;
+        }
+    } else if ((iocon & MCP_IOCON_BANK) == 0) {
+        mcp_pointer = (mcp_pointer + 1) % MCP_SIM_REGISTERS;
+    } else {
+        mcp_pointer++;
+        if ((mcp_pointer & 0x0F) > 0x0A) {
+            mcp_pointer = (mcp_pointer < 0x10) ? 0x10 : 0x00;
+        }
+    }
+}
+
+//************************************************************************
+// mcp_write : write the register at the address pointer
+// =========
+//
+static void mcp_write(uint8_t value)
+{
+uint8_t   index, old_pins;
+
+    index = mcp_index(mcp_pointer);
+    sim_event(SIM_MCP_WRITE, mcp_pointer, value);
+    if (index == MCP_SIM_REGISTERS) {
+        return;
+    }
+    switch (index & 0xFE) {
+        case IOCON :
+            mcp_sim_regs[IOCON] = value;        // one register at both addresses
+            mcp_sim_regs[IOCON + 1] = value;
+            return;
+        case INTF :
+        case INTCAP :
+            return;                             // read only
+        case GPIO :
+            index += (OLAT - GPIO);             // a GPIO write sets the latch
+            break;
+    }
+    old_pins = mcp_sim_regs[OLAT] & ~mcp_sim_regs[IODIR];
+    mcp_sim_regs[index] = value;
+    hd_pins(old_pins, mcp_sim_regs[OLAT] & ~mcp_sim_regs[IODIR]);
+}
+
+//************************************************************************
+// mcp_read : read the register at the address pointer
+// ========
+//
+static uint8_t mcp_read(void)
+{
+uint8_t   index, port, inputs, value;
+
+    index = mcp_index(mcp_pointer);
+    value = 0;
+    if (index < MCP_SIM_REGISTERS) {
+        value = mcp_sim_regs[index];
+        if ((index & 0xFE) == GPIO) {
+            port = index & 0x01;
+            inputs = (port) ? (uint8_t)(mcp_sim_inputs >> 8) : (uint8_t)mcp_sim_inputs;
+            inputs ^= mcp_sim_regs[IPOL + port];
+            value = (mcp_sim_regs[OLAT + port] & ~mcp_sim_regs[IODIR + port]) |
+                    (inputs & mcp_sim_regs[IODIR + port]);
+        }
+    }
+    sim_event(SIM_MCP_READ, mcp_pointer, value);
+    return value;
+}
+
+//************************************************************************
+// lcd03_drain : empty the input buffer at the display's rate
+// ===========
+//
+static void lcd03_drain(void)
+{
+uint16_t  taken;
+
+    if (Tick_Elapsed(lcd03_drain_tick) > 40) {
+        lcd03_pending = 0;                  // long idle : Timer1 may have wrapped
+    }
+    taken = (uint16_t)(I2C_Stats_Time() - lcd03_drain_time) / LCD03_SIM_BYTE_COUNTS;
+    if (taken >= lcd03_pending) {
+        lcd03_pending = 0;
+        lcd03_drain_time = I2C_Stats_Time();
+    } else {
+        lcd03_pending -= (uint8_t)taken;
+        lcd03_drain_time += taken * LCD03_SIM_BYTE_COUNTS;
+    }
+    lcd03_drain_tick = Tick_Get();
+}
+
+//************************************************************************
+// lcd03_clear : blank the screen and home the cursor
+// ===========
+//
+static void lcd03_clear(void)
+{
+uint8_t   row, column;
+
+    for (row=0 ; row < LCD03_SIM_ROWS ; row++) {
+        for (column=0 ; column < LCD03_SIM_COLUMNS ; column++) {
+            lcd03_screen[row][column] = ' ';
+        }
+    }
+    lcd03_row = 0;
+    lcd03_column = 0;
+}
+
+//************************************************************************
+// lcd03_byte : act on a byte written to the command register
+// ==========
+//
+// Notes
+//    Commands 2 (position 1-80), 3 (row 1-4, column 1-20) and 18 (tab
+//    size) take arguments.  Other command codes below 32 that are not
+//    modelled are recorded and ignored.
+//
+static void lcd03_byte(uint8_t value)
+{
+    lcd03_drain();
+    if (lcd03_pending >= LCD03_SIM_BUFFER) {
+        sim_event(SIM_LCD03_OVERFLOW, 0, value);
+        return;
+    }
+    lcd03_pending++;
+
+    if (lcd03_args != 0) {
+        lcd03_args--;
+        if (lcd03_command == SET_ROW_COL_CURSOR) {
+            if (lcd03_args != 0) {
+                lcd03_arg = value;
+                return;
+            }
+            if ((lcd03_arg >= 1) && (lcd03_arg <= LCD03_SIM_ROWS) &&
+                (value >= 1) && (value <= LCD03_SIM_COLUMNS)) {
+                lcd03_row = lcd03_arg - 1;
+                lcd03_column = value - 1;
+            }
+        } else if (lcd03_command == 2) {
+            if ((value >= 1) && (value <= (LCD03_SIM_ROWS * LCD03_SIM_COLUMNS))) {
+                lcd03_row = (value - 1) / LCD03_SIM_COLUMNS;
+                lcd03_column = (value - 1) % LCD03_SIM_COLUMNS;
+            }
+        } else {                            // 18 : tab size
+            if ((value >= 1) && (value <= 10)) {
+                lcd03_tab = value;
+            }
+        }
+        return;
+    }
+
+    if (value >= ' ') {
+        sim_event(SIM_LCD03_DATA, (lcd03_row * LCD03_SIM_COLUMNS) + lcd03_column, value);
+        lcd03_screen[lcd03_row][lcd03_column] = value;
+        if (++lcd03_column >= LCD03_SIM_COLUMNS) {
+            lcd03_column = 0;
+            lcd03_row = (lcd03_row + 1) % LCD03_SIM_ROWS;
+        }
+        return;
+    }
+    sim_event(SIM_LCD03_COMMAND, 0, value);
+    switch (value) {
+        case 1 :                            // cursor home
+            lcd03_row = 0;
+            lcd03_column = 0;
+            break;
+        case 2 :
+        case 18 :
+            lcd03_command = value;
+            lcd03_args = 1;
+            break;
+        case SET_ROW_COL_CURSOR :
+            lcd03_command = value;
+            lcd03_args = 2;
+            break;
+        case 8 :                            // backspace
+            if (lcd03_column != 0) {
+                lcd03_column--;
+                lcd03_screen[lcd03_row][lcd03_column] = ' ';
+            }
+            break;
+        case 9 :                            // horizontal tab
+            lcd03_column = ((lcd03_column / lcd03_tab) + 1) * lcd03_tab;
+            if (lcd03_column >= LCD03_SIM_COLUMNS) {
+                lcd03_column = LCD03_SIM_COLUMNS - 1;
+            }
+            break;
+        case 10 :                           // line feed
+            lcd03_row = (lcd03_row + 1) % LCD03_SIM_ROWS;
+            break;
+        case 11 :                           // vertical tab : up a line
+            lcd03_row = (lcd03_row == 0) ? (LCD03_SIM_ROWS - 1) : (lcd03_row - 1);
+            break;
+        case CLEAR_SCREEN :
+            lcd03_clear();
+            break;
+        case 13 :                           // carriage return
+            lcd03_column = 0;
+            break;
+        case 19 :
+            lcd03_sim_backlight = 1;
+            break;
+        case 20 :
+            lcd03_sim_backlight = 0;
+            break;
+    }
+}
+
+//************************************************************************
+// lcd03_read : read the register at the read pointer
+// ==========
+//
+static uint8_t lcd03_read(void)
+{
+uint8_t   value;
+
+    switch (lcd03_pointer) {
+        case REGISTER_0 :
+            lcd03_drain();
+            value = LCD03_SIM_BUFFER - lcd03_pending;
+            break;
+        case REGISTER_1 :
+            value = (uint8_t)lcd03_sim_keypad;
+            break;
+        case REGISTER_2 :
+            value = (uint8_t)(lcd03_sim_keypad >> 8);
+            break;
+        default :
+            value = LCD03_SIM_VERSION;
+            break;
+    }
+    lcd03_pointer = (lcd03_pointer + 1) & 0x03;
+    return value;
+}
+
+//************************************************************************
+// I2C_Sim_Init : put the models in their power-on state
+// ============
+//
+// Notes
+//    Call after I2C_Stats_Init(), which starts Timer1.
+//
+void I2C_Sim_Init(void)
+{
+uint8_t   row, column;
+
+    for (row=0 ; row < MCP_SIM_REGISTERS ; row++) {
+        mcp_sim_regs[row] = 0;
+    }
+    mcp_sim_regs[IODIR] = 0xFF;             // all inputs
+    mcp_sim_regs[IODIR + 1] = 0xFF;
+    mcp_sim_inputs = 0xFFFF;
+    mcp_pointer = 0;
+
+    for (row=0 ; row < LCD_ROWS ; row++) {
+        for (column=0 ; column < LCD_COLUMNS ; column++) {
+            hd44780_screen[row][column] = ' ';
+        }
+    }
+    hd_eight_bit = 1;
+    hd_have_high = 0;
+    hd_address = 0;
+    hd_increment = 1;
+    hd_busy_counts = 0;
+    hd_busy_tick = Tick_Get();
+    hd44780_busy_errors = 0;
+
+    lcd03_clear();
+    lcd03_pointer = REGISTER_0;
+    lcd03_args = 0;
+    lcd03_tab = LCD03_SIM_TAB;
+    lcd03_pending = 0;
+    lcd03_drain_time = I2C_Stats_Time();
+    lcd03_drain_tick = Tick_Get();
+    lcd03_sim_keypad = 0;
+    lcd03_sim_backlight = 1;
+
+    I2C_Sim_Reset_Stats();
+}
+
+//************************************************************************
+// I2C_Sim_Reset_Stats : clear the bus time, counters and events
+// ===================
+//
+void I2C_Sim_Reset_Stats(void)
+{
+    i2c_sim_stats.transfers = 0;
+    i2c_sim_stats.nacks = 0;
+    i2c_sim_stats.bus_time = 0;
+    i2c_sim_event_count = 0;
+}
+
+//************************************************************************
+// I2C_Sim_Transfer : answer a transfer from the device models
+// ================
+//
+// Description
+//    Called by I2C_Transfer() in place of the bus.  Returns I2C_OK, or
+//    I2C_ERR_NACK if there is no model at the address.
+//
+// Notes
+//    The first byte written sets the register pointer of the device, as
+//    on the real parts; the read phase continues from it.
+//
+uint8_t I2C_Sim_Transfer(I2C_XFER *xfer)
+{
+uint8_t   i, count, period;
+uint16_t  clocks;
+
+    count = xfer->header_count + xfer->payload_count;
+    clocks = 2 + (9 * (1 + (uint16_t)count));           // start, address, bytes, stop
+    if ((xfer->mode != WRITE_ONLY) && (xfer->reply_count != 0)) {
+        clocks += 9 * (1 + (uint16_t)xfer->reply_count);
+        clocks += (xfer->mode == MODE_RESTART) ? 1 : 2;
+    }
+    period = (i2c_speed == I2C_SPEED_400KHZ) ? (I2C_400KHZ + 1) : (I2C_100KHZ + 1);     // SCL period, 0.1uS
+    i2c_sim_stats.transfers++;
+    i2c_sim_stats.bus_time += (uint32_t)clocks * period;
+
+    if (xfer->address == MCP23017_ADDRESS) {
+        for (i=0 ; i < count ; i++) {
+            if (i == 0) {
+                mcp_pointer = sim_byte(xfer, 0);
+            } else {
+                mcp_write(sim_byte(xfer, i));
+                mcp_next();
+            }
+        }
+        if (xfer->mode != WRITE_ONLY) {
+            for (i=0 ; i < xfer->reply_count ; i++) {
+                xfer->reply[i] = mcp_read();
+                mcp_next();
+            }
+        }
+        return I2C_OK;
+    }
+
+    if (xfer->address == LCD03_ADDRESS) {
+        for (i=0 ; i < count ; i++) {
+            if (i == 0) {
+                lcd03_pointer = sim_byte(xfer, 0) & 0x03;
+            } else if (lcd03_pointer == REGISTER_0) {
+                lcd03_byte(sim_byte(xfer, i));
+            }
+        }
+        if (xfer->mode != WRITE_ONLY) {
+            for (i=0 ; i < xfer->reply_count ; i++) {
+                xfer->reply[i] = lcd03_read();
+            }
+        }
+        return I2C_OK;
+    }
+
+    i2c_sim_stats.nacks++;
+    sim_event(SIM_NACK, xfer->address, 0);
+    return I2C_ERR_NACK;
+}
+
+#endif  // I2C_SIM
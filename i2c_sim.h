@@ -0,0 +1,105 @@
+//
+// i2c_sim.h : behavioural models of the I2C devices
+//
+#ifndef _I2C_SIM_H
+#define _I2C_SIM_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// With I2C_SIM defined, I2C_Transfer() hands every transfer to the
+// device models instead of the SSP, so the firmware runs in the MPLAB
+// simulator (or on a bare board) with no buggy attached.  The models
+// are timed with the I2C_STATS Timer1 time base.
+//
+#if defined(I2C_SIM) && !defined(I2C_STATS)
+#error "I2C_SIM needs I2C_STATS"
+#endif
+
+#define     I2C_SIM_EVENTS               64       // power of 2
+//
+// Event types : what a model saw, in 'i2c_sim_events'
+//
+#define     SIM_MCP_WRITE                 0       // MCP23017 register written : reg, value
+#define     SIM_MCP_READ                  1       // MCP23017 register read : reg, value
+#define     SIM_HD_COMMAND                2       // HD44780 instruction : value
+#define     SIM_HD_DATA                   3       // HD44780 character : reg = DDRAM address, value
+#define     SIM_HD_BUSY                   4       // HD44780 strobed while busy : value = nibble
+#define     SIM_LCD03_COMMAND             5       // LCD03 command byte : value
+#define     SIM_LCD03_DATA                6       // LCD03 character : reg = cursor position, value
+#define     SIM_LCD03_OVERFLOW            7       // LCD03 byte lost, input buffer full : value
+#define     SIM_NACK                      8       // no model at the address : reg = address
+//
+// MCP23017 : 22 registers, kept in IOCON.BANK = 0 order (see mcp23017.h)
+//
+#define     MCP_SIM_REGISTERS            22
+#define     MCP_IOCON_BANK             0x80
+#define     MCP_IOCON_SEQOP            0x20
+//
+// HD44780 execution times in Timer1 counts (0.8uS) : clear and home take
+// 1.52mS, every other instruction and a data write 37uS
+//
+#define     HD44780_SLOW_COUNTS        1900
+#define     HD44780_FAST_COUNTS          47
+//
+// LCD03 : 4*20 display, 64 byte input buffer emptied at one byte every
+// LCD03_SIM_BYTE_COUNTS (about 100uS)
+//
+#define     LCD03_SIM_ROWS                4
+#define     LCD03_SIM_COLUMNS            20
+#define     LCD03_SIM_BUFFER             64
+#define     LCD03_SIM_BYTE_COUNTS       125
+#define     LCD03_SIM_VERSION             5
+#define     LCD03_SIM_TAB                 4       // default tab size
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+typedef struct {
+       uint16_t  tick;                // system tick
+       uint16_t  time;                // Timer1 count (0.8uS)
+       uint8_t   type;                // SIM_xxx
+       uint8_t   reg;
+       uint8_t   value;
+} I2C_SIM_EVENT;
+
+//
+// Bus time is what the transfers would take on the wire at the selected
+// speed : start, 9 clocks per byte (with the acknowledge), restart and
+// stop, each one SCL period.
+//
+typedef struct {
+       uint16_t  transfers;
+       uint16_t  nacks;
+       uint32_t  bus_time;            // 0.1uS units
+} I2C_SIM_STATS;
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern I2C_SIM_STATS   i2c_sim_stats;
+extern I2C_SIM_EVENT   i2c_sim_events[I2C_SIM_EVENTS];
+extern uint16_t        i2c_sim_event_count;   // events recorded : next is i2c_sim_events[count % SIZE]
+
+extern uint8_t         mcp_sim_regs[MCP_SIM_REGISTERS];
+extern uint16_t        mcp_sim_inputs;        // levels on the expander's input pins (B:A)
+
+extern char            hd44780_screen[LCD_ROWS][LCD_COLUMNS];
+extern uint16_t        hd44780_busy_errors;
+
+extern char            lcd03_screen[LCD03_SIM_ROWS][LCD03_SIM_COLUMNS];
+extern uint16_t        lcd03_sim_keypad;      // keypad state returned in registers 1 and 2
+extern uint8_t         lcd03_sim_backlight;
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void     I2C_Sim_Init(void);
+void     I2C_Sim_Reset_Stats(void);
+uint8_t  I2C_Sim_Transfer(I2C_XFER *xfer);
+
+#endif //_I2C_SIM_H
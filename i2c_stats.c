@@ -0,0 +1,219 @@
+//
+// i2c_stats.c : I2C bus instrumentation
+//
+// Built in when I2C_STATS is defined in defines.h.  Every I2C_Transfer()
+// is timed with Timer1 and counted against its device address.  The
+// counters can be shown on the TextLCD with I2C_Stats_Show() or read
+// directly from 'i2c_stats'.
+//
+// With I2C_TRACE also defined, each transfer is logged with its start
+// time and duration in 'i2c_trace'.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+#ifdef I2C_STATS
+
+//************************************************************************
+// Global variables
+//
+I2C_DEV_STATS   i2c_stats[I2C_STATS_DEVICES];
+uint8_t         i2c_utilisation;
+
+static uint32_t  slice_busy[I2C_STATS_SLICES];   // completed slices
+static uint32_t  current_busy;                   // slice being filled
+static uint8_t   slice_index;
+static uint16_t  slice_start;                    // tick at start of current slice
+
+#ifdef I2C_TRACE
+I2C_TRACE_EVENT  i2c_trace[I2C_TRACE_SIZE];
+uint16_t         i2c_trace_count;
+#endif
+
+//************************************************************************
+// I2C_Stats_Init : start the bus timer and clear the counters
+// ==============
+//
+// Notes
+//    Timer1 is read only; its interrupt is not used.  Call after Tick_Init().
+//
+void I2C_Stats_Init(void)
+{
+    OpenTimer1(TIMER_INT_OFF & T1_16BIT_RW & T1_SOURCE_INT & T1_PS_1_8 & T1_OSC1EN_OFF & T1_SYNC_EXT_OFF);
+    I2C_Stats_Reset();
+}
+
+//************************************************************************
+// I2C_Stats_Reset : clear the counters and the utilisation window
+// ===============
+//
+void I2C_Stats_Reset(void)
+{
+uint8_t   i;
+
+    for (i=0 ; i < I2C_STATS_DEVICES ; i++) {
+        i2c_stats[i].address = I2C_STATS_FREE;
+        i2c_stats[i].transactions = 0;
+        i2c_stats[i].bytes_written = 0;
+        i2c_stats[i].bytes_read = 0;
+        i2c_stats[i].nacks = 0;
+        i2c_stats[i].timeouts = 0;
+        i2c_stats[i].busy = 0;
+    }
+    i2c_stats[I2C_STATS_DEVICES - 1].address = I2C_STATS_OTHER;
+    for (i=0 ; i < I2C_STATS_SLICES ; i++) {
+        slice_busy[i] = 0;
+    }
+    current_busy = 0;
+    slice_index = 0;
+    slice_start = Tick_Get();
+    i2c_utilisation = 0;
+#ifdef I2C_TRACE
+    i2c_trace_count = 0;
+#endif
+}
+
+//************************************************************************
+// I2C_Stats_Time : read the bus timer
+// ==============
+//
+uint16_t I2C_Stats_Time(void)
+{
+    return (ReadTimer1());
+}
+
+//************************************************************************
+// I2C_Stats_Record : count a completed transfer
+// ================
+//
+// Description
+//    Called by I2C_Transfer() as it returns, with the I2C_Stats_Time()
+//    value taken on entry.  The result is taken from xfer->status.
+//
+void I2C_Stats_Record(I2C_XFER *xfer, uint16_t start)
+{
+uint8_t         i;
+uint16_t        elapsed;
+I2C_DEV_STATS   *stats;
+#ifdef I2C_TRACE
+I2C_TRACE_EVENT   *event;
+#endif
+
+    elapsed = ReadTimer1() - start;
+    stats = &i2c_stats[I2C_STATS_DEVICES - 1];
+    for (i=0 ; i < (I2C_STATS_DEVICES - 1) ; i++) {
+        if (i2c_stats[i].address == xfer->address) {
+            stats = &i2c_stats[i];
+            break;
+        }
+        if (i2c_stats[i].address == I2C_STATS_FREE) {
+            i2c_stats[i].address = xfer->address;
+            stats = &i2c_stats[i];
+            break;
+        }
+    }
+    stats->transactions++;
+    stats->busy += elapsed;
+    switch (xfer->status) {
+        case I2C_OK :
+            stats->bytes_written += xfer->header_count + xfer->payload_count;
+            if (xfer->mode != WRITE_ONLY) {
+                stats->bytes_read += xfer->reply_count;
+            }
+            break;
+        case I2C_ERR_NACK :
+            stats->nacks++;
+            break;
+        default :
+            stats->timeouts++;
+            break;
+    }
+    I2C_Stats_Update();
+    current_busy += elapsed;
+#ifdef I2C_TRACE
+    event = &i2c_trace[i2c_trace_count & (I2C_TRACE_SIZE - 1)];
+    event->tick = Tick_Get();
+    event->start = start;
+    event->duration = elapsed;
+    event->address = xfer->address;
+    event->reg = (xfer->header_count != 0) ? xfer->header[0] : 0;
+    event->count = xfer->header_count + xfer->payload_count;
+    if (xfer->mode != WRITE_ONLY) {
+        event->count += xfer->reply_count;
+    }
+    event->status = xfer->status;
+    i2c_trace_count++;
+#endif
+}
+
+//************************************************************************
+// I2C_Stats_Update : move the utilisation window on
+// ================
+//
+// Notes
+//    Called on every transfer and from the foreground idle loop, so the
+//    window keeps moving while the bus is quiet.
+//
+void I2C_Stats_Update(void)
+{
+uint8_t    i, slices;
+uint32_t   total;
+
+    slices = 0;
+    while ((Tick_Elapsed(slice_start) >= I2C_STATS_SLICE_TICKS) && (slices < I2C_STATS_SLICES)) {
+        slice_busy[slice_index] = current_busy;
+        current_busy = 0;
+        slice_index = (slice_index + 1) % I2C_STATS_SLICES;
+        slice_start += I2C_STATS_SLICE_TICKS;
+        slices++;
+    }
+    if (slices == 0) {
+        return;
+    }
+    if (slices == I2C_STATS_SLICES) {
+        slice_start = Tick_Get();           // idle for a whole window
+    }
+    total = 0;
+    for (i=0 ; i < I2C_STATS_SLICES ; i++) {
+        total += slice_busy[i];
+    }
+    i2c_utilisation = (uint8_t)(total / I2C_STATS_PERCENT_COUNTS);
+}
+
+//************************************************************************
+// I2C_Stats_Show : show the counters for one device on the TextLCD
+// ==============
+//
+// Description
+//    Row 0 : "I2C xxx% dev aa"     bus utilisation and device address
+//    Row 1 : "ttttt bbbbb Eeee"    transactions, bytes and errors
+//
+void I2C_Stats_Show(uint8_t index)
+{
+char   number[8];
+
+    if (index >= I2C_STATS_DEVICES) {
+        return;
+    }
+    TextLCD_cls();
+    TextLCD_locate(0,0);
+    TextLCD_putstring_rom("I2C ");
+    uint16_to_asc(number, i2c_utilisation, 3, 0);
+    TextLCD_putstring(number);
+    TextLCD_putstring_rom("% dev ");
+    hex16_to_asc(number, i2c_stats[index].address, 2);
+    TextLCD_putstring(number);
+
+    TextLCD_locate(1,0);
+    uint16_to_asc(number, i2c_stats[index].transactions, 5, 0);
+    TextLCD_putstring(number);
+    TextLCD_putchar(' ');
+    uint16_to_asc(number, i2c_stats[index].bytes_written + i2c_stats[index].bytes_read, 5, 0);
+    TextLCD_putstring(number);
+    TextLCD_putchar('E');
+    uint16_to_asc(number, i2c_stats[index].nacks + i2c_stats[index].timeouts, 3, 0);
+    TextLCD_putstring(number);
+}
+
+#endif  // I2C_STATS
@@ -0,0 +1,89 @@
+//
+// i2c_stats.h : I2C bus instrumentation
+//
+#ifndef _I2C_STATS_H
+#define _I2C_STATS_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// Bus time is measured with Timer1, free running from Fosc/4 with a 1:8
+// prescale (0.8uS per count).  A single transfer must complete within
+// one Timer1 wrap (52mS).
+//
+#define     I2C_STATS_COUNTS_PER_MS    1250
+//
+// Utilisation is the bus time over a sliding window of I2C_STATS_SLICES
+// slices, each I2C_STATS_SLICE_TICKS mS long, so the figure moves every
+// 250mS and covers the last second.
+//
+#define     I2C_STATS_SLICE_TICKS       250
+#define     I2C_STATS_SLICES              4
+#define     I2C_STATS_PERCENT_COUNTS   ((uint32_t)I2C_STATS_SLICE_TICKS * I2C_STATS_SLICES * I2C_STATS_COUNTS_PER_MS / 100)
+//
+// Counters are kept for the first I2C_STATS_DEVICES-1 addresses used; any
+// further devices share the last entry, marked I2C_STATS_OTHER.
+//
+#define     I2C_STATS_DEVICES             4
+#define     I2C_STATS_FREE             0x00
+#define     I2C_STATS_OTHER            0xFF
+//
+// With I2C_TRACE defined the last I2C_TRACE_SIZE transfers are kept, in
+// order, so that a driver change can be checked event by event.
+//
+#define     I2C_TRACE_SIZE               32       // power of 2
+
+#if defined(I2C_TRACE) && !defined(I2C_STATS)
+#error "I2C_TRACE needs I2C_STATS"
+#endif
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+// The 16-bit counters wrap; the bus time is held in 32 bits (57 minutes).
+//
+typedef struct {
+       uint8_t   address;             // 7-bit address, I2C_STATS_FREE or I2C_STATS_OTHER
+       uint16_t  transactions;        // calls to I2C_Transfer()
+       uint16_t  bytes_written;       // header and payload bytes (successful transfers)
+       uint16_t  bytes_read;          // reply bytes (successful transfers)
+       uint16_t  nacks;
+       uint16_t  timeouts;            // timeouts and collisions : both recover the bus
+       uint32_t  busy;                // Timer1 counts spent in I2C_Transfer()
+} I2C_DEV_STATS;
+
+typedef struct {
+       uint16_t  tick;                // system tick at the end of the transfer
+       uint16_t  start;               // Timer1 count at the start of the transfer
+       uint16_t  duration;            // Timer1 counts (0.8uS)
+       uint8_t   address;             // 7-bit device address
+       uint8_t   reg;                 // first header byte (register or command)
+       uint8_t   count;               // bytes written + bytes read
+       uint8_t   status;              // I2C_OK or error code
+} I2C_TRACE_EVENT;
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern I2C_DEV_STATS   i2c_stats[I2C_STATS_DEVICES];
+extern uint8_t         i2c_utilisation;          // % of the last second spent on the bus
+#ifdef I2C_TRACE
+extern I2C_TRACE_EVENT   i2c_trace[I2C_TRACE_SIZE];
+extern uint16_t          i2c_trace_count;     // events recorded : next is i2c_trace[count % SIZE]
+#endif
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void      I2C_Stats_Init(void);
+void      I2C_Stats_Reset(void);
+uint16_t  I2C_Stats_Time(void);
+void      I2C_Stats_Record(I2C_XFER *xfer, uint16_t start);
+void      I2C_Stats_Update(void);
+void      I2C_Stats_Show(uint8_t index);
+
+#endif //_I2C_STATS_H
@@ -0,0 +1,102 @@
+//
+// interrupts.c : interrupt vectors and service routines
+//
+// The service routines only poll the enabled sources and call the
+// relevant driver handler.  Handlers must clear their own flag.  See
+// interrupts.h for the priority assignments and shared state rules.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// high_vector : jump from the high priority vector to its service routine
+// ===========
+//
+#pragma code high_vector=0x08
+void high_vector(void)
+{
+    _asm GOTO high_isr _endasm
+}
+#pragma code
+
+//************************************************************************
+// low_vector : jump from the low priority vector to its service routine
+// ==========
+//
+#pragma code low_vector=0x18
+void low_vector(void)
+{
+    _asm GOTO low_isr _endasm
+}
+#pragma code
+
+//************************************************************************
+// Interrupts_Init : enable priority levels and assign sources
+// ===============
+//
+// Notes
+//    Called before any interrupt source is enabled.  Interrupts stay
+//    globally disabled until Interrupts_Enable().
+//
+void Interrupts_Init(void)
+{
+    INTCONbits.GIEH = 0;
+    INTCONbits.GIEL = 0;
+    RCONbits.IPEN = 1;
+
+    IPR1bits.TMR2IP = 1;              // high : PWM timebase
+    IPR1bits.ADIP   = 1;              // high : current sense, stall, reflex
+    INTCON2bits.TMR0IP = 0;           // low  : system tick
+    IPR1bits.SSPIP  = 0;              // low  : I2C
+    IPR2bits.BCLIP  = 0;
+    IPR1bits.TXIP   = 0;              // low  : serial
+    IPR1bits.RCIP   = 0;
+}
+
+//************************************************************************
+// Interrupts_Enable : globally enable both priority levels
+// =================
+//
+void Interrupts_Enable(void)
+{
+    INTCONbits.GIEL = 1;
+    INTCONbits.GIEH = 1;
+}
+
+//************************************************************************
+// high_isr : high priority interrupt service routine
+// ========
+//
+// Notes
+//    The handlers are C functions, so the compiler temporary data and
+//    maths library sections must be saved along with PROD.
+//
+#pragma interrupt high_isr save=PROD,section(".tmpdata"),section("MATH_DATA")
+void high_isr(void)
+{
+    if (PIE1bits.TMR2IE && PIR1bits.TMR2IF) {
+        ADC_Trigger_ISR();
+    }
+    if (PIE1bits.ADIE && PIR1bits.ADIF) {
+        ADC_ISR();
+    }
+}
+
+//************************************************************************
+// low_isr : low priority interrupt service routine
+// =======
+//
+#pragma interruptlow low_isr save=PROD,section(".tmpdata"),section("MATH_DATA")
+void low_isr(void)
+{
+    if (INTCONbits.TMR0IE && INTCONbits.TMR0IF) {
+        Tick_ISR();
+    }
+    if (PIE1bits.TXIE && PIR1bits.TXIF) {
+        UART_TX_ISR();
+    }
+    if (PIE1bits.RCIE && PIR1bits.RCIF) {
+        UART_RX_ISR();
+    }
+}
@@ -0,0 +1,55 @@
+//
+// interrupts.h : interrupt vector and service routine declarations
+//
+// Interrupt architecture
+// ======================
+//
+// Two interrupt priority levels are used (RCON.IPEN = 1) :-
+//
+//   HIGH (vector 0x08)  motor control : PWM timebase (TMR2), motor current,
+//                       stall protection and obstacle reflex (A/D).
+//                       INT0/INT1 (RB0/RB1) are reserved for wheel encoders.
+//   LOW  (vector 0x18)  system tick (TMR0), I2C (SSP) and serial (EUSART).
+//   foreground          sequence interpreter and display.
+//
+// The A/D interrupt runs at high priority although it also carries the
+// channel scanner, because the reflex and stall checks are made on each
+// conversion and cannot wait behind the low priority work.
+//
+// Worst case latency budget (Tcy = 0.1uS)
+//
+//   HIGH  entry (3 Tcy) + context save                        ~5uS
+//         each handler must finish inside                      30uS
+//         the TMR2 + 3 A/D chain per 200uS PWM period totals  <60uS
+//   LOW   held off by at most one PWM period's high chain      60uS
+//         each handler must finish inside                     100uS
+//   FORE  no bound; receives at least 60% of the CPU
+//
+// Shared state rules
+//
+//   1. Variables written at interrupt level are volatile.
+//   2. Single byte values written by one level may be read by another
+//      without protection.  Setting or clearing a single bit is a single
+//      BSF/BCF instruction and is also safe.
+//   3. Multi-byte values, and read-modify-write of a byte that an
+//      interrupt also writes, are accessed with the writer's level
+//      disabled : GIEL for low priority data, GIEH (which also holds off
+//      low priority) for high priority data.  Keep these sections short.
+//   4. A function is called from one level only; C18 functions are not
+//      re-entrant.
+//   5. Interrupt handlers never block, never wait on the I2C bus and never
+//      call the display drivers.
+//
+#ifndef _INTERRUPTS_H
+#define _INTERRUPTS_H
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void  Interrupts_Init(void);
+void  Interrupts_Enable(void);
+void  high_isr(void);
+void  low_isr(void);
+
+#endif //_INTERRUPTS_H
@@ -18,171 +18,163 @@
 
 #include	"defines.h"
 
-//
-// create an I2C data structure for the (2*20) 7-segment interface unit
-//
-I2C_STRUCT   MCP23017_command;
-
-uint8_t      MCP23017_i2cAddress;        // physical I2C address
-uint16_t     shadow_GPIO, shadow_IODIR, shadow_GPPU, shadow_IPOL;     // Cached copies of the register values
-
-union {
-    uint8_t  value8[2];
-    uint16_t value16;
-} tmp_data;
-
 //-----------------------------------------------------------------------------
 // MCP23017_reset
 // --------------
 // Set configuration (IOCON) and direction(IODIR) registers to initial state
 //
-void MCP23017_reset(uint8_t  i2c_address) 
+void MCP23017_reset(MCP23017_DEVICE *dev, uint8_t  i2c_address) 
 {
 int  reg_addr;
 
-	MCP23017_i2cAddress	= i2c_address;
+	dev->address = i2c_address;
 //
 // First make sure that the device is in BANK=0 mode
 //
-    MCP23017_writeRegister_uint8(0x05, (uint8_t)0x00);
+    MCP23017_writeRegister_uint8(dev, 0x05, (uint8_t)0x00);
 //
 // set direction registers to inputs
 //
-    MCP23017_writeRegister_uint16(IODIR, (uint16_t)0xFFFF);
+    MCP23017_writeRegister_uint16(dev, IODIR, (uint16_t)0xFFFF);
 //
 // set all other registers to zero (last of 10 registers is OLAT)
 //
     for (reg_addr = 2 ; reg_addr <= OLAT ; reg_addr+=2) {
-        MCP23017_writeRegister_uint16(reg_addr, (uint16_t)0x0000);
+        MCP23017_writeRegister_uint16(dev, reg_addr, (uint16_t)0x0000);
     }
 //
 // Set the shadow registers to power-on state
 //
-    shadow_IODIR = 0xFFFF;
-    shadow_GPIO  = 0;
-    shadow_GPPU  = 0;
-    shadow_IPOL  = 0;
+    dev->shadow_IODIR = 0xFFFF;
+    dev->shadow_GPIO  = 0;
+    dev->shadow_GPPU  = 0;
+    dev->shadow_IPOL  = 0;
 }
 
 /*-----------------------------------------------------------------------------
  * write_bit
  * Write a 1/0 to a single bit of the 16-bit port
  */
-void MCP23017_write_bit(uint8_t value, uint8_t bit_number) {
+void MCP23017_write_bit(MCP23017_DEVICE *dev, uint8_t value, uint8_t bit_number) {
     if (value == 0) {
-        shadow_GPIO &= ~((uint16_t)1 << bit_number);
+        dev->shadow_GPIO &= ~((uint16_t)1 << bit_number);
     } else {
-        shadow_GPIO |= (uint16_t)1 << bit_number;
+        dev->shadow_GPIO |= (uint16_t)1 << bit_number;
     }
-    MCP23017_writeRegister_uint16(GPIO, (uint16_t)shadow_GPIO);
+    MCP23017_writeRegister_uint16(dev, GPIO, (uint16_t)dev->shadow_GPIO);
 }
 
 /*-----------------------------------------------------------------------------
  * Write a combination of bits to the 16-bit port
  */
-void MCP23017_write_mask(uint16_t data, uint16_t mask) {
-    shadow_GPIO = (shadow_GPIO & ~mask) | data;
-    MCP23017_writeRegister_uint16(GPIO, (uint16_t)shadow_GPIO);
+void MCP23017_write_mask(MCP23017_DEVICE *dev, uint16_t data, uint16_t mask) {
+    dev->shadow_GPIO = (dev->shadow_GPIO & ~mask) | data;
+    MCP23017_writeRegister_uint16(dev, GPIO, (uint16_t)dev->shadow_GPIO);
+}
+
+/*-----------------------------------------------------------------------------
+ * post_bit
+ * As write_bit, but the port write is posted : it is combined with any
+ * other pending GPIO write and reaches the device at the next I2C_Flush()
+ * or ordered write.  Use for LEDs and other status outputs.
+ */
+void MCP23017_post_bit(MCP23017_DEVICE *dev, uint8_t value, uint8_t bit_number) {
+    if (value == 0) {
+        dev->shadow_GPIO &= ~((uint16_t)1 << bit_number);
+    } else {
+        dev->shadow_GPIO |= (uint16_t)1 << bit_number;
+    }
+    I2C_Post_Register(dev->address, GPIO, (const uint8_t *)&dev->shadow_GPIO, 2, I2C_POSTED);
+}
+
+/*-----------------------------------------------------------------------------
+ * post_mask
+ * Posted version of write_mask
+ */
+void MCP23017_post_mask(MCP23017_DEVICE *dev, uint16_t data, uint16_t mask) {
+    dev->shadow_GPIO = (dev->shadow_GPIO & ~mask) | data;
+    I2C_Post_Register(dev->address, GPIO, (const uint8_t *)&dev->shadow_GPIO, 2, I2C_POSTED);
 }
 
 /*-----------------------------------------------------------------------------
  * read_bit
  * Read a single bit from the 16-bit port
  */
-uint16_t  MCP23017_read_bit(uint16_t bit_number) {
-    shadow_GPIO = MCP23017_readRegister(GPIO);
-    return  ((shadow_GPIO >> bit_number) & 0x0001);
+uint16_t  MCP23017_read_bit(MCP23017_DEVICE *dev, uint16_t bit_number) {
+    dev->shadow_GPIO = MCP23017_readRegister(dev, GPIO);
+    return  ((dev->shadow_GPIO >> bit_number) & 0x0001);
 }
 
 /*-----------------------------------------------------------------------------
  * read_mask
  */
-uint16_t  MCP23017_read_mask(uint8_t mask) {
-    shadow_GPIO = MCP23017_readRegister(GPIO);
-    return (shadow_GPIO & mask);
+uint16_t  MCP23017_read_mask(MCP23017_DEVICE *dev, uint8_t mask) {
+    dev->shadow_GPIO = MCP23017_readRegister(dev, GPIO);
+    return (dev->shadow_GPIO & mask);
 }
 
 /*-----------------------------------------------------------------------------
  * Config
  * set direction and pull-up registers
  */
-void MCP23017_config(uint16_t dir_config, uint16_t pullup_config,  uint16_t polarity_config) {
-    shadow_IODIR = dir_config;
-    MCP23017_writeRegister_uint16(IODIR, (uint16_t)shadow_IODIR);
-    shadow_GPPU = pullup_config;
-    MCP23017_writeRegister_uint16(GPPU, (uint16_t)shadow_GPPU);
-    shadow_IPOL = polarity_config;
-    MCP23017_writeRegister_uint16(IPOL, (uint16_t)shadow_IPOL);
+void MCP23017_config(MCP23017_DEVICE *dev, uint16_t dir_config, uint16_t pullup_config,  uint16_t polarity_config) {
+    dev->shadow_IODIR = dir_config;
+    MCP23017_writeRegister_uint16(dev, IODIR, (uint16_t)dev->shadow_IODIR);
+    dev->shadow_GPPU = pullup_config;
+    MCP23017_writeRegister_uint16(dev, GPPU, (uint16_t)dev->shadow_GPPU);
+    dev->shadow_IPOL = polarity_config;
+    MCP23017_writeRegister_uint16(dev, IPOL, (uint16_t)dev->shadow_IPOL);
 }
 
 /*-----------------------------------------------------------------------------
  * writeRegister
- * write a byte
+ * write a byte (ordered : sent after any pending posted writes)
  */
-void MCP23017_writeRegister_uint8(uint8_t regAddress, uint8_t data) 
+void MCP23017_writeRegister_uint8(MCP23017_DEVICE *dev, uint8_t regAddress, uint8_t data) 
 {
-
-    MCP23017_command.cmd[0] = MCP23017_i2cAddress;
-    MCP23017_command.cmd[1] = regAddress;
-    MCP23017_command.cmd[2] = data;
-    MCP23017_command.send_count = 3;
-    MCP23017_command.get_count = 0;
-    MCP23017_command.delay = 0;
-    exec_command(&MCP23017_command, WRITE_ONLY);
+    I2C_Post_Register(dev->address, regAddress, &data, 1, I2C_ORDERED);
 }
 
 /*----------------------------------------------------------------------------
  * write Register
- * write two bytes
+ * write two bytes (the PIC is little-endian, so the A register is sent first)
+ * (ordered : sent after any pending posted writes)
  */ 
-void MCP23017_writeRegister_uint16(uint8_t regAddress, uint16_t data) 
+void MCP23017_writeRegister_uint16(MCP23017_DEVICE *dev, uint8_t regAddress, uint16_t data) 
 {
-    tmp_data.value16 = data;
-
-    MCP23017_command.cmd[0] = MCP23017_i2cAddress;
-    MCP23017_command.cmd[1] = regAddress;
-    MCP23017_command.cmd[2] = tmp_data.value8[0];
-    MCP23017_command.cmd[3] = tmp_data.value8[1];
-    MCP23017_command.send_count = 4;
-    MCP23017_command.get_count = 0;
-    MCP23017_command.delay = 0;
-    exec_command(&MCP23017_command, WRITE_ONLY);
+    I2C_Post_Register(dev->address, regAddress, (const uint8_t *)&data, 2, I2C_ORDERED);
 }
 
 /*-----------------------------------------------------------------------------
  * readRegister
+ * read a register pair (A then B)
  */
-int MCP23017_readRegister(uint8_t regAddress) {
-    char buffer[2];
-
-    MCP23017_command.cmd[0] = MCP23017_i2cAddress;
-    MCP23017_command.cmd[1] = regAddress;
-    MCP23017_command.send_count = 2;
-    MCP23017_command.get_count = 1;
-    MCP23017_command.delay = 0;
-    exec_command(&MCP23017_command, WRITE_ONLY);
+int MCP23017_readRegister(MCP23017_DEVICE *dev, uint8_t regAddress) {
+    uint16_t value;
 
-    return ((int)(buffer[0] + (buffer[1]<<8)));
+    value = 0;
+    I2C_Read_Register(dev->address, regAddress, (uint8_t *)&value, 2);
+    return ((int)value);
 }
 
 /*-----------------------------------------------------------------------------
  * pinMode
  */
-void MCP23017_pinMode(int pin, int mode) {
+void MCP23017_pinMode(MCP23017_DEVICE *dev, int pin, int mode) {
     if (DIR_INPUT) {
-        shadow_IODIR |= 1 << pin;
+        dev->shadow_IODIR |= 1 << pin;
     } else {
-        shadow_IODIR &= ~(1 << pin);
+        dev->shadow_IODIR &= ~(1 << pin);
     }
-    MCP23017_writeRegister_uint16(IODIR, (uint16_t)shadow_IODIR);
+    MCP23017_writeRegister_uint16(dev, IODIR, (uint16_t)dev->shadow_IODIR);
 }
 
 /*-----------------------------------------------------------------------------
  * digitalRead
  */
-int MCP23017_digitalRead(int pin) {
-    shadow_GPIO = MCP23017_readRegister(GPIO);
-    if ( shadow_GPIO & (1 << pin)) {
+int MCP23017_digitalRead(MCP23017_DEVICE *dev, int pin) {
+    dev->shadow_GPIO = MCP23017_readRegister(dev, GPIO);
+    if ( dev->shadow_GPIO & (1 << pin)) {
         return 1;
     } else {
         return 0;
@@ -192,7 +184,7 @@ int MCP23017_digitalRead(int pin) {
 /*-----------------------------------------------------------------------------
  * digitalWrite
  */
-void MCP23017_digitalWrite(int pin, int val) 
+void MCP23017_digitalWrite(MCP23017_DEVICE *dev, int pin, int val) 
 {
 uint8_t   isOutput;
 
@@ -200,60 +192,60 @@ uint8_t   isOutput;
     //enable the internal pullup
     //otherwise, it will set the OUTPUT voltage
     //as appropriate.
-    isOutput = !(shadow_IODIR & 1<<pin);
+    isOutput = !(dev->shadow_IODIR & 1<<pin);
 
     if (isOutput) {
         //This is an output pin so just write the value
-        if (val) shadow_GPIO |= 1 << pin;
-        else shadow_GPIO &= ~(1 << pin);
-        MCP23017_writeRegister_uint16(GPIO, (uint16_t)shadow_GPIO);
+        if (val) dev->shadow_GPIO |= 1 << pin;
+        else dev->shadow_GPIO &= ~(1 << pin);
+        MCP23017_writeRegister_uint16(dev, GPIO, (uint16_t)dev->shadow_GPIO);
     } else {
         //This is an input pin, so we need to enable the pullup
         if (val) {
-            shadow_GPPU |= 1 << pin;
+            dev->shadow_GPPU |= 1 << pin;
         } else {
-            shadow_GPPU &= ~(1 << pin);
+            dev->shadow_GPPU &= ~(1 << pin);
         }
-        MCP23017_writeRegister_uint16(GPPU, (uint16_t)shadow_GPPU);
+        MCP23017_writeRegister_uint16(dev, GPPU, (uint16_t)dev->shadow_GPPU);
     }
 }
 
 /*-----------------------------------------------------------------------------
  * digitalWordRead
  */
-uint16_t MCP23017_digitalWordRead(void) {
-    shadow_GPIO = MCP23017_readRegister(GPIO);
-    return shadow_GPIO;
+uint16_t MCP23017_digitalWordRead(MCP23017_DEVICE *dev) {
+    dev->shadow_GPIO = MCP23017_readRegister(dev, GPIO);
+    return dev->shadow_GPIO;
 }
 
 /*-----------------------------------------------------------------------------
  * digitalWordWrite
  */
-void MCP23017_digitalWordWrite(uint16_t w) {
-    shadow_GPIO = w;
-    MCP23017_writeRegister_uint16(GPIO, (uint16_t)shadow_GPIO);
+void MCP23017_digitalWordWrite(MCP23017_DEVICE *dev, uint16_t w) {
+    dev->shadow_GPIO = w;
+    MCP23017_writeRegister_uint16(dev, GPIO, (uint16_t)dev->shadow_GPIO);
 }
 
 /*-----------------------------------------------------------------------------
  * inputPolarityMask
  */
-void MCP23017_inputPolarityMask(uint16_t mask) {
-    MCP23017_writeRegister_uint16(IPOL, mask);
+void MCP23017_inputPolarityMask(MCP23017_DEVICE *dev, uint16_t mask) {
+    MCP23017_writeRegister_uint16(dev, IPOL, mask);
 }
 
 /*-----------------------------------------------------------------------------
  * inputoutputMask
  */
-void MCP23017_inputOutputMask(uint16_t mask) {
-    shadow_IODIR = mask;
-    MCP23017_writeRegister_uint16(IODIR, (uint16_t)shadow_IODIR);
+void MCP23017_inputOutputMask(MCP23017_DEVICE *dev, uint16_t mask) {
+    dev->shadow_IODIR = mask;
+    MCP23017_writeRegister_uint16(dev, IODIR, (uint16_t)dev->shadow_IODIR);
 }
 
 /*-----------------------------------------------------------------------------
  * internalPullupMask
  */
-void MCP23017_internalPullupMask(uint16_t mask) {
-    shadow_GPPU = mask;
-    MCP23017_writeRegister_uint16(GPPU, (uint16_t)shadow_GPPU);
+void MCP23017_internalPullupMask(MCP23017_DEVICE *dev, uint16_t mask) {
+    dev->shadow_GPPU = mask;
+    MCP23017_writeRegister_uint16(dev, GPPU, (uint16_t)dev->shadow_GPPU);
 }
 
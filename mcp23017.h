@@ -37,82 +37,123 @@
 #define     OLAT        0x14
 
 #define     I2C_BASE_ADDRESS    0x40
+#define     MCP23017_ADDRESS    0x20      // 7-bit address of the breakout board expander
+#define     MCP23017_MAX_DEVICES   8      // addresses 0x20 -> 0x27 (A2..A0 pins)
 
 #define     DIR_OUTPUT      0
 #define     DIR_INPUT       1
 
+//****************************************************************
+// Device handle : one per fitted expander, owned by the caller and
+// passed as the first parameter of every function.  Each device keeps
+// its own cached copies of the registers so that bit operations do not
+// need a read-modify-write on the bus.
+//****************************************************************
+
+typedef struct {
+    uint8_t   address;                   // 7-bit I2C address
+    uint16_t  shadow_GPIO;               // cached copies of the register values
+    uint16_t  shadow_IODIR;
+    uint16_t  shadow_GPPU;
+    uint16_t  shadow_IPOL;
+} MCP23017_DEVICE;
+
 //****************************************************************
 // Function prototypes
 //****************************************************************
 
 /** MCP23017_reset : Reset MCP23017 device to its power-on state
+ *
+ * @param   dev           device handle to initialise
+ * @param   i2c_address   7-bit address of the device (0x20 -> 0x27)
  */    
-void MCP23017_reset(uint8_t  i2c_address);
+void MCP23017_reset(MCP23017_DEVICE *dev, uint8_t  i2c_address);
 
 /** MCP23017_write_bit : Write a 0/1 value to an output bit
  *
+ * @param   dev           device handle
  * @param   value         0 or 1
  * @param   bit_number    bit number range 0 --> 15
  */   
-void MCP23017_write_bit(uint8_t value, uint8_t bit_number);
+void MCP23017_write_bit(MCP23017_DEVICE *dev, uint8_t value, uint8_t bit_number);
       
 /** MCP23017_write_mask : Write a masked 16-bit value to the device
  *
+ * @param   dev     device handle
+ * @param   data    16-bit data value
+ * @param   mask    16-bit mask value
+ */       
+void MCP23017_write_mask(MCP23017_DEVICE *dev, uint16_t data, uint16_t mask);
+
+/** MCP23017_post_bit : Posted (write-combined) version of MCP23017_write_bit
+ *
+ * @param   dev           device handle
+ * @param   value         0 or 1
+ * @param   bit_number    bit number range 0 --> 15
+ */   
+void MCP23017_post_bit(MCP23017_DEVICE *dev, uint8_t value, uint8_t bit_number);
+
+/** MCP23017_post_mask : Posted (write-combined) version of MCP23017_write_mask
+ *
+ * @param   dev     device handle
  * @param   data    16-bit data value
  * @param   mask    16-bit mask value
  */       
-void MCP23017_write_mask(uint16_t data, uint16_t mask);
+void MCP23017_post_mask(MCP23017_DEVICE *dev, uint16_t data, uint16_t mask);
 
 /** MCP23017_read_bit : Read a 0/1 value from an input bit
  *
+ * @param   dev           device handle
  * @param   bit_number    bit number range 0 --> 15
  * @return                0/1 value read
  */       
-uint16_t  MCP23017_read_bit(uint16_t bit_number);
+uint16_t  MCP23017_read_bit(MCP23017_DEVICE *dev, uint16_t bit_number);
     
 /** MCP23017_read_mask : Read a 16-bit value from the device and apply mask
  *
+ * @param   dev     device handle
  * @param   mask    16-bit mask value
  * @return          16-bit data with mask applied
  */     
-uint16_t  MCP23017_read_mask(uint8_t mask);
+uint16_t  MCP23017_read_mask(MCP23017_DEVICE *dev, uint8_t mask);
 
 /** MCP23017_config : Configure an MCP23017 device
  *
+ * @param   dev           device handle
  * @param   dir_config         data direction value (1 = input, 0 = output)
  * @param   pullup_config      100k pullup value (1 = enabled, 0 = disabled)
  * @param   polarity_config    polarity value (1 = flip, 0 = normal)
  */           
-void MCP23017_config(uint16_t dir_config, uint16_t pullup_config, uint16_t polarity_config);
+void MCP23017_config(MCP23017_DEVICE *dev, uint16_t dir_config, uint16_t pullup_config, uint16_t polarity_config);
 
-void MCP23017_writeRegister_uint8(uint8_t regAddress, uint8_t  val);
-void MCP23017_writeRegister_uint16(uint8_t regAddress, uint16_t val);
+void MCP23017_writeRegister_uint8(MCP23017_DEVICE *dev, uint8_t regAddress, uint8_t  val);
+void MCP23017_writeRegister_uint16(MCP23017_DEVICE *dev, uint8_t regAddress, uint16_t val);
 
-int  MCP23017_readRegister(uint8_t regAddress);
+int  MCP23017_readRegister(MCP23017_DEVICE *dev, uint8_t regAddress);
 
 /*----------------------------------------------------------------------------- 
  * pinmode
  * Set units to sequential, bank0 mode
  */  
-void MCP23017_pinMode(int pin, int mode); 
-void MCP23017_digitalWrite(int pin, int val);
-int  MCP23017_digitalRead(int pin);
+void MCP23017_pinMode(MCP23017_DEVICE *dev, int pin, int mode); 
+void MCP23017_digitalWrite(MCP23017_DEVICE *dev, int pin, int val);
+int  MCP23017_digitalRead(MCP23017_DEVICE *dev, int pin);
 
 // These provide a more advanced mapping of the chip functionality
 // See the data sheet for more information on what they do
 
 //Returns a word with the current pin states (ie contents of the GPIO register)
-uint16_t MCP23017_digitalWordRead(void);
+uint16_t MCP23017_digitalWordRead(MCP23017_DEVICE *dev);
 // Allows you to write a word to the GPIO register
-void MCP23017_digitalWordWrite(uint16_t w);
+void MCP23017_digitalWordWrite(MCP23017_DEVICE *dev, uint16_t w);
 // Sets up the polarity mask that the MCP23017 supports
 // if set to 1, it will flip the actual pin value.
-void MCP23017_inputPolarityMask(uint16_t mask);
+void MCP23017_inputPolarityMask(MCP23017_DEVICE *dev, uint16_t mask);
 //Sets which pins are inputs or outputs (1 = input, 0 = output) NB Opposite to arduino's
 //definition for these
-    void MCP23017_inputOutputMask(uint16_t mask);
+    void MCP23017_inputOutputMask(MCP23017_DEVICE *dev, uint16_t mask);
 // Allows enabling of the internal 100k pullup resisters (1 = enabled, 0 = disabled)
-void MCP23017_internalPullupMask(uint16_t mask);
+void MCP23017_internalPullupMask(MCP23017_DEVICE *dev, uint16_t mask);
 int MCP23017_read(void);
 void MCP23017_write(int data);
 
@@ -5,36 +5,203 @@
 //
 #include      "defines.h"
 
+//************************************************************************
+// Number formatting
+//
+// The PIC18 has no divide instruction, and every '/' or '%' on a 16-bit
+// value is a call to the C18 library division routine.  The routines
+// below extract decimal digits by repeated subtraction of powers of ten
+// instead (at most 9 compare/subtract steps per digit, 36 in all), and
+// hex digits with shifts and a table.
+//
+rom static uint16_t  powers_of_ten[4] = {10000, 1000, 100, 10};
+rom static char      hex_digits[16] = {'0','1','2','3','4','5','6','7',
+                                       '8','9','A','B','C','D','E','F'};
+
+//************************************************************************
+// num_to_asc : common formatter for the decimal conversions
+// ==========
+//
+// Parameters
+//    str      : output buffer, must hold max(width, 8) + 1 characters
+//    mag      : magnitude of the number
+//    negative : non-zero if a '-' sign is required
+//    width    : minimum field width (0 == as narrow as possible)
+//    places   : digits after the decimal point (0 -> 4)
+//    flags    : FMT_ZERO_PAD, FMT_PLUS
+//
+// Returns number of characters written (excluding the '\0')
+//
+static uint8_t num_to_asc(char *str, uint16_t mag, uint8_t negative,
+                          uint8_t width, uint8_t places, uint8_t flags)
+{
+char      digits[5];
+uint8_t   i, first, count, len;
+uint16_t  power;
+char      sign;
+
+    for (i=0 ; i < 4 ; i++) {
+        power = powers_of_ten[i];
+        digits[i] = '0';
+        while (mag >= power) {
+            mag -= power;
+            digits[i]++;
+        }
+    }
+    digits[4] = '0' + (uint8_t)mag;
+
+    first = 0;
+    while ((first < 4) && (digits[first] == '0')) {
+        first++;
+    }
+    if (places > 4) {
+        places = 4;
+    }
+    if (first > (4 - places)) {
+        first = 4 - places;
+    }
+
+    sign = 0;
+    if (negative) {
+        sign = '-';
+    } else if (flags & FMT_PLUS) {
+        sign = '+';
+    }
+    len = 5 - first;
+    if (places != 0) {
+        len++;
+    }
+    if (sign != 0) {
+        len++;
+    }
+
+    count = 0;
+    if ((flags & FMT_ZERO_PAD) && (sign != 0)) {
+        str[count++] = sign;
+        sign = 0;
+    }
+    while (len < width) {
+        str[count++] = (flags & FMT_ZERO_PAD) ? '0' : ' ';
+        width--;
+    }
+    if (sign != 0) {
+        str[count++] = sign;
+    }
+    for (i = first ; i < 5 ; i++) {
+        if ((places != 0) && (i == (5 - places))) {
+            str[count++] = '.';
+        }
+        str[count++] = digits[i];
+    }
+    str[count] = '\0';
+    return count;
+}
+
 //************************************************************************
 // int16_to_asc : convert INT16 to ASCII string
 // ============
 //
-UINT8 int16_to_asc(char *str, INT16 num) 
+uint8_t int16_to_asc(char *str, int16_t num) 
+{ 
+    if (num < 0) {
+        return num_to_asc(str, (uint16_t)0 - (uint16_t)num, 1, 0, 0, 0);
+    }
+    return num_to_asc(str, (uint16_t)num, 0, 0, 0, 0);
+}
+
+//************************************************************************
+// int16_to_asc_fmt : convert INT16 to ASCII in a formatted field
+// ================
+//
+uint8_t int16_to_asc_fmt(char *str, int16_t num, uint8_t width, uint8_t flags) 
+{ 
+    if (num < 0) {
+        return num_to_asc(str, (uint16_t)0 - (uint16_t)num, 1, width, 0, flags);
+    }
+    return num_to_asc(str, (uint16_t)num, 0, width, 0, flags);
+}
+
+//************************************************************************
+// uint16_to_asc : convert UINT16 to ASCII in a formatted field
+// =============
+//
+uint8_t uint16_to_asc(char *str, uint16_t num, uint8_t width, uint8_t flags) 
+{ 
+    return num_to_asc(str, num, 0, width, 0, flags);
+}
+
+//************************************************************************
+// fixed16_to_asc : convert a fixed point INT16 to ASCII
+// ==============
+//
+// Description
+//    'num' holds the value scaled by 10^places, e.g. 7205 with 3 places
+//    is output as "7.205".  Width includes the sign and decimal point.
+//
+uint8_t fixed16_to_asc(char *str, int16_t num, uint8_t places, uint8_t width, uint8_t flags) 
+{ 
+    if (num < 0) {
+        return num_to_asc(str, (uint16_t)0 - (uint16_t)num, 1, width, places, flags);
+    }
+    return num_to_asc(str, (uint16_t)num, 0, width, places, flags);
+}
+
+//************************************************************************
+// hex16_to_asc : convert UINT16 to a fixed number of hex digits
+// ============
+//
+// Notes
+//    'digits' is 1 -> 4; the least significant digits are output.
+//
+uint8_t hex16_to_asc(char *str, uint16_t num, uint8_t digits) 
 { 
-INT16   k; 
-char    c, *ostr;
-UINT8   flag, ch_count;
-
-    ch_count = 0;
-	if (num < 0) { 
-		num = -num; 
-		*str++ = '-'; 
-        ch_count++;
-	} 
-	k = 10000; 
-	ostr = str;
-	flag = 0; 
-	while (k != 0) { 
-		c = num / k; 
-		if ((c > 0) || (k == 1) || (flag == 1)) { 
-			num %= k; 
-			c += '0'; 
-			*str++ = c; 
-            ch_count++;
-			flag = 1; 
-		} 
-		k /= 10; 
-	} 
-	*str = '\0'; 
-	return ch_count; 
+uint8_t  i;
+
+    if (digits > 4) {
+        digits = 4;
+    }
+    str[digits] = '\0';
+    for (i = digits ; i != 0 ; i--) {
+        str[i - 1] = hex_digits[num & 0x0F];
+        num >>= 4;
+    }
+    return digits;
+}
+
+//************************************************************************
+// CRC-16/CCITT (polynomial 0x1021, initial value CRC16_INIT)
+//
+// A nibble at a time from a 16 entry table : 32 bytes of program memory
+// rather than 512 for a byte table, and no bit loop.
+//
+rom static uint16_t  crc16_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+//************************************************************************
+// crc16_byte : add one byte to a running CRC
+// ==========
+//
+uint16_t crc16_byte(uint16_t crc, uint8_t data)
+{
+    crc = (crc << 4) ^ crc16_table[(uint8_t)(crc >> 12) ^ (data >> 4)];
+    crc = (crc << 4) ^ crc16_table[(uint8_t)(crc >> 12) ^ (data & 0x0F)];
+    return crc;
+}
+
+//************************************************************************
+// crc16_update : add a block of bytes to a running CRC
+// ============
+//
+// Notes
+//    Start with crc = CRC16_INIT.  "123456789" gives 0x29B1.
+//
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint8_t count)
+{
+    while (count != 0) {
+        crc = crc16_byte(crc, *data++);
+        count--;
+    }
+    return crc;
 }
@@ -8,11 +8,23 @@
 // Constant declarations
 //************************************************************************
 //
+// number formatting flags
+//
+#define     FMT_ZERO_PAD     0x01      // pad field with leading zeros rather than spaces
+#define     FMT_PLUS         0x02      // output '+' for positive values
+
+#define     CRC16_INIT       0xFFFF    // initial value for crc16_update()
 //
 //************************************************************************
 // System functions : prototypes.
 //************************************************************************
 //
 uint8_t int16_to_asc(char *str, int16_t num); 
+uint8_t int16_to_asc_fmt(char *str, int16_t num, uint8_t width, uint8_t flags); 
+uint8_t uint16_to_asc(char *str, uint16_t num, uint8_t width, uint8_t flags); 
+uint8_t fixed16_to_asc(char *str, int16_t num, uint8_t places, uint8_t width, uint8_t flags); 
+uint8_t hex16_to_asc(char *str, uint16_t num, uint8_t digits); 
+uint16_t crc16_byte(uint16_t crc, uint8_t data);
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint8_t count);
 
 #endif //_MISC_LIB_H
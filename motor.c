@@ -0,0 +1,73 @@
+//
+// motor.c : drive motor current sensing and stall protection
+//
+// Current samples arrive from the A/D interrupt routine, one per motor per
+// PWM period, taken a fixed time after the start of the on-phase.  A motor
+// drawing more than STALL_CURRENT_LIMIT for STALL_PERIODS consecutive
+// periods is treated as stalled and both motors are cut before the
+// H-bridge overheats.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// Global variables
+//
+volatile uint16_t  motor_current[2];
+volatile uint8_t   motor_stall;
+
+static uint8_t     stall_count[2];
+
+//************************************************************************
+// Motor_Current_Init : clear current estimates and stall state
+// ==================
+//
+void Motor_Current_Init(void)
+{
+    motor_current[RIGHT_MOTOR] = 0;
+    motor_current[LEFT_MOTOR] = 0;
+    stall_count[RIGHT_MOTOR] = 0;
+    stall_count[LEFT_MOTOR] = 0;
+    motor_stall = 0;
+}
+
+//************************************************************************
+// Motor_Current_Sample : process a synchronised current sample
+// ====================
+//
+// Description
+//    Called at interrupt level.  The estimate is a first order filter
+//    with a gain of 1/4 (result is 4 * mean sample).  When the duty is too
+//    short for the sample point to fall inside the on-phase the sample is
+//    discarded.
+//
+void Motor_Current_Sample(uint8_t motor, uint16_t sample)
+{
+uint8_t  duty;
+
+    if (motor == RIGHT_MOTOR) {
+        duty = RIGHT_DUTY_REG;
+    } else {
+        duty = LEFT_DUTY_REG;
+    }
+    if (duty < CURRENT_SENSE_MIN_DUTY) {
+        if (duty == 0) {
+            motor_current[motor] = 0;
+        }
+        stall_count[motor] = 0;
+        return;
+    }
+    motor_current[motor] = motor_current[motor] - (motor_current[motor] >> 2) + sample;
+
+    if (sample > STALL_CURRENT_LIMIT) {
+        if (++stall_count[motor] >= STALL_PERIODS) {
+            MOTORS_OFF();
+            motor_stall |= (motor == RIGHT_MOTOR) ? RIGHT_STALL : LEFT_STALL;
+            seq_events |= EVENT_STALL;
+            stall_count[motor] = 0;
+        }
+    } else {
+        stall_count[motor] = 0;
+    }
+}
@@ -0,0 +1,68 @@
+//
+// motor.h : drive motor pin assignments and current sensing
+//
+#ifndef _MOTOR_H
+#define _MOTOR_H
+
+//************************************************************************
+// Pin and register assignments
+//************************************************************************
+//
+#if defined(__18F452)
+#define RIGHT_MOTOR_DIR_TRIS   	TRISBbits.TRISB0 
+#define RIGHT_MOTOR_DIR			PORTBbits.RB0
+#define LEFT_MOTOR_DIR_TRIS   	TRISBbits.TRISB1 
+#define LEFT_MOTOR_DIR  		PORTBbits.RB1
+#define RIGHT_DUTY_REG          CCPR1L
+#define LEFT_DUTY_REG           CCPR2L
+#define MOTORS_OFF()            { CCPR1L = 0; CCPR2L = 0; CCP1CON &= 0xCF; CCP2CON &= 0xCF; }
+#endif
+
+#if defined(__18F4585)
+#define RIGHT_MOTOR_DIR_TRIS   	TRISBbits.TRISB5 
+#define RIGHT_MOTOR_DIR			PORTBbits.RB5
+#define LEFT_MOTOR_DIR_TRIS   	TRISBbits.TRISB4 
+#define LEFT_MOTOR_DIR  		PORTBbits.RB4
+#define RIGHT_DUTY_REG          CCPR1L
+#define LEFT_DUTY_REG           ECCPR1L
+#define MOTORS_OFF()            { CCPR1L = 0; ECCPR1L = 0; CCP1CON &= 0xCF; ECCP1CON &= 0xCF; }
+#endif
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+#define     SET_FORWARD         0         // direction pin values
+#define     SET_REVERSE         1
+
+#define     PWM_PERIOD          124       // PR2 : 200uS period at 40MHz, 1:16 prescale
+#define     PWM_MAX_DUTY        (4 * (PWM_PERIOD + 1))
+
+#define     RIGHT_MOTOR         0
+#define     LEFT_MOTOR          1
+
+#define     RIGHT_STALL         0x01      // bits in 'motor_stall'
+#define     LEFT_STALL          0x02
+//
+// Current sense limits.  Samples are 10-bit A/D counts of the H-bridge
+// sense resistor voltage taken at a fixed point in the PWM on-phase.
+//
+#define     CURRENT_SENSE_MIN_DUTY   25   // duty register value (20%) below which the on-phase is too short to sample
+#define     STALL_CURRENT_LIMIT     800   // A/D counts
+#define     STALL_PERIODS             2   // consecutive PWM periods over the limit before cut-out
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern volatile uint16_t  motor_current[2];     // filtered current, A/D counts * 4
+extern volatile uint8_t   motor_stall;          // latched stall flags
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void  Motor_Current_Init(void);
+void  Motor_Current_Sample(uint8_t motor, uint16_t sample);
+
+#endif //_MOTOR_H
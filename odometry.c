@@ -0,0 +1,157 @@
+//
+// odometry.c : dead-reckoning model of the vehicle's motion
+//
+// Built in when ODOMETRY is defined in defines.h.  The vehicle has no
+// wheel encoders, so the position is estimated from what the motors are
+// being asked to do : the PWM duty registers and direction pins are read
+// every ODO_STEP_MS and fed through a differential-drive model with
+// first order motor lag, supply voltage and a fixed wheel slip.
+//
+// The model runs in the foreground from Odometry_Update(), which catches
+// up on the steps due since the last call, so it costs nothing at
+// interrupt level.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+#ifdef ODOMETRY
+
+//************************************************************************
+// Quarter wave sine table : sin(i * 90 / 64 degrees) * 16384, i = 0 -> 64
+//
+rom static int16_t sine_table[65] = {
+        0,   402,   804,  1205,  1606,  2006,  2404,  2801,
+     3196,  3590,  3981,  4370,  4756,  5139,  5520,  5897,
+     6270,  6639,  7005,  7366,  7723,  8076,  8423,  8765,
+     9102,  9434,  9760, 10080, 10394, 10702, 11003, 11297,
+    11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395,
+    13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978,
+    15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986,
+    16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379,
+    16384
+};
+
+//************************************************************************
+// Module variables
+//
+static int32_t   odo_x, odo_y;                  // Q8 mm
+static uint16_t  odo_heading;                   // binary angle
+static int16_t   odo_v_right, odo_v_left;       // Q4 mm/S
+static uint16_t  odo_tick;                      // tick of the last step
+
+//************************************************************************
+// odo_sin : sine of a binary angle, * 16384
+// =======
+//
+static int16_t odo_sin(uint16_t angle)
+{
+uint8_t   index;
+
+    index = (uint8_t)(angle >> 8);
+    switch (index >> 6) {
+        case 0 :  return ( sine_table[index & 0x3F]);
+        case 1 :  return ( sine_table[64 - (index & 0x3F)]);
+        case 2 :  return (-sine_table[index & 0x3F]);
+        default : return (-sine_table[64 - (index & 0x3F)]);
+    }
+}
+
+//************************************************************************
+// odo_target : steady state wheel speed for a duty register and direction
+// ==========
+//
+// Notes
+//    The duty register holds the top 8 of the 10 duty bits.  Speed is
+//    taken as proportional to the mean motor voltage, i.e. duty * supply.
+//
+static int16_t odo_target(uint8_t duty_reg, uint8_t direction, uint16_t millivolts)
+{
+int32_t   speed;
+
+    speed = ((int32_t)duty_reg * 4 * ODO_MAX_SPEED_MM_S * ODO_SPEED_ONE) / PWM_MAX_DUTY;
+    speed = (speed * millivolts) / BATTERY_NOMINAL_MV;
+    if (direction == SET_REVERSE) {
+        speed = -speed;
+    }
+    return ((int16_t)speed);
+}
+
+//************************************************************************
+// Odometry_Init : set the start point and start the model
+// =============
+//
+void Odometry_Init(void)
+{
+    odo_x = 0;
+    odo_y = 0;
+    odo_heading = 0;
+    odo_v_right = 0;
+    odo_v_left = 0;
+    odo_tick = Tick_Get();
+}
+
+//************************************************************************
+// Odometry_Update : advance the model to the current time
+// ===============
+//
+// Notes
+//    Call often (the sequence wait loop and every dispatch).  The motor
+//    inputs are read once per call and used for all the steps caught up,
+//    so the error from a change of speed is at most the time since the
+//    previous call.  After a gap of more than ODO_MAX_STEPS the rest of
+//    the gap is dropped.
+//
+void Odometry_Update(void)
+{
+uint8_t    steps;
+uint16_t   millivolts;
+int16_t    right_target, left_target, ground_right, ground_left;
+int32_t    distance;
+
+    if (Tick_Elapsed(odo_tick) < ODO_STEP_MS) {
+        return;
+    }
+    millivolts = Battery_Millivolts();
+    right_target = odo_target(RIGHT_DUTY_REG, RIGHT_MOTOR_DIR, millivolts);
+    left_target = odo_target(LEFT_DUTY_REG, LEFT_MOTOR_DIR, millivolts);
+
+    for (steps=0 ; steps < ODO_MAX_STEPS ; steps++) {
+        if (Tick_Elapsed(odo_tick) < ODO_STEP_MS) {
+            break;
+        }
+        odo_tick += ODO_STEP_MS;
+//
+// motor lag, then wheel slip
+//
+        odo_v_right += (right_target - odo_v_right) / ODO_LAG_DIV;
+        odo_v_left += (left_target - odo_v_left) / ODO_LAG_DIV;
+        ground_right = (int16_t)(((int32_t)odo_v_right * ODO_TRACTION) / 256);
+        ground_left = (int16_t)(((int32_t)odo_v_left * ODO_TRACTION) / 256);
+//
+// move along the current heading, then turn
+//
+        distance = ((int32_t)(ground_right + ground_left) * ODO_DIST_NUM) / 512;
+        odo_x += (distance * odo_sin((uint16_t)(odo_heading + 0x4000))) / 16384;
+        odo_y += (distance * odo_sin(odo_heading)) / 16384;
+        odo_heading += (uint16_t)(((int32_t)(ground_right - ground_left) * ODO_TURN_NUM) / 256);
+    }
+    if (steps == ODO_MAX_STEPS) {
+        odo_tick = Tick_Get();
+    }
+}
+
+//************************************************************************
+// Odometry_Get : read the estimated pose
+// ============
+//
+void Odometry_Get(ODO_POSE *pose)
+{
+    pose->x_mm = (int16_t)(odo_x / 256);
+    pose->y_mm = (int16_t)(odo_y / 256);
+    pose->heading = odo_heading;
+    pose->right_speed = odo_v_right / ODO_SPEED_ONE;
+    pose->left_speed = odo_v_left / ODO_SPEED_ONE;
+}
+
+#endif  // ODOMETRY
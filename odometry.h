@@ -0,0 +1,55 @@
+//
+// odometry.h : dead-reckoning model of the vehicle's motion
+//
+#ifndef _ODOMETRY_H
+#define _ODOMETRY_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// Vehicle model.  Wheel speeds are held in mm/S * 16 (Q4), positions in
+// mm * 256 (Q8) and the heading as a binary angle (65536 = 360 degrees,
+// 0 = the heading at Odometry_Init(), increasing anticlockwise).
+// The speed, track and traction figures are calibration values for the
+// WattBot I chassis and should be checked against a measured run.
+//
+#define     ODO_STEP_MS               10       // model time step
+#define     ODO_MAX_STEPS             20       // steps caught up per call (200mS)
+#define     ODO_MAX_SPEED_MM_S       300       // wheel speed at full duty and BATTERY_NOMINAL_MV
+#define     ODO_TRACK_MM             150       // distance between the wheel centres
+#define     ODO_LAG_DIV                8       // motor lag : time constant ODO_LAG_DIV steps (80mS)
+#define     ODO_TRACTION             243       // ground speed / wheel speed * 256 (5% slip)
+//
+// Per step :  distance (Q8 mm)   = (v_right + v_left) / 2 * ODO_DIST_NUM / 256
+//             heading (binary)   = (v_right - v_left) * ODO_TURN_NUM / 256
+// where  ODO_DIST_NUM = 256 * 256 * step(S) / 16
+//        ODO_TURN_NUM = 256 * 65536 / (2 * pi) * step(S) / (16 * track)
+//
+#define     ODO_SPEED_ONE             16                 // Q4 scale
+#define     ODO_DIST_DEN          (ODO_SPEED_ONE * 1000L)
+#define     ODO_TURN_DEN          (ODO_SPEED_ONE * 1000L * ODO_TRACK_MM)
+#define     ODO_DIST_NUM          ((int16_t)((65536L * ODO_STEP_MS + ODO_DIST_DEN / 2) / ODO_DIST_DEN))
+#define     ODO_TURN_NUM          ((int16_t)((10430L * 256 * ODO_STEP_MS + ODO_TURN_DEN / 2) / ODO_TURN_DEN))
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+typedef struct {
+       int16_t   x_mm;                // distance forward of the start point
+       int16_t   y_mm;                // distance to the left of the start point
+       uint16_t  heading;             // binary angle
+       int16_t   right_speed;         // modelled wheel speeds, mm/S
+       int16_t   left_speed;
+} ODO_POSE;
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void  Odometry_Init(void);
+void  Odometry_Update(void);
+void  Odometry_Get(ODO_POSE *pose);
+
+#endif //_ODOMETRY_H
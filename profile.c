@@ -0,0 +1,101 @@
+//
+// profile.c : sequence interpreter profiler
+//
+// Built in when SEQ_PROFILE is defined in defines.h.  exec_seq() calls
+// Profile_Start() before each dispatch and Profile_Stop() after it, and
+// the count and time are added to the entry for the opcode.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+#ifdef SEQ_PROFILE
+
+//************************************************************************
+// Global variables
+//
+PROFILE_ENTRY   seq_profile[PROFILE_MAX_COMMANDS];
+uint16_t        profile_dispatches;
+
+static uint16_t  profile_start;
+
+//************************************************************************
+// Profile_Init : start the profile timer and clear the counters
+// ============
+//
+// Notes
+//    Timer1 is set up as for I2C_STATS, so both can be built in together.
+//
+void Profile_Init(void)
+{
+    OpenTimer1(TIMER_INT_OFF & T1_16BIT_RW & T1_SOURCE_INT & T1_PS_1_8 & T1_OSC1EN_OFF & T1_SYNC_EXT_OFF);
+    Profile_Reset();
+}
+
+//************************************************************************
+// Profile_Reset : clear the counters
+// =============
+//
+void Profile_Reset(void)
+{
+uint8_t   i;
+
+    for (i=0 ; i < PROFILE_MAX_COMMANDS ; i++) {
+        seq_profile[i].count = 0;
+        seq_profile[i].time = 0;
+    }
+    profile_dispatches = 0;
+}
+
+//************************************************************************
+// Profile_Start : mark the start of a dispatch
+// =============
+//
+void Profile_Start(void)
+{
+    profile_start = ReadTimer1();
+}
+
+//************************************************************************
+// Profile_Stop : charge the time since Profile_Start() to a command
+// ============
+//
+void Profile_Stop(uint8_t command)
+{
+uint16_t  elapsed;
+
+    elapsed = ReadTimer1() - profile_start;
+    profile_dispatches++;
+    if (command < PROFILE_MAX_COMMANDS) {
+        seq_profile[command].count++;
+        seq_profile[command].time += elapsed;
+    }
+}
+
+//************************************************************************
+// Profile_Cycles_Per_Command : mean instruction cycles per dispatch
+// ==========================
+//
+// Description
+//    Averaged over every command counted since Profile_Reset().  Returns 0
+//    if nothing has been counted.
+//
+uint16_t Profile_Cycles_Per_Command(void)
+{
+uint8_t    i;
+uint16_t   count;
+uint32_t   time;
+
+    count = 0;
+    time = 0;
+    for (i=0 ; i < PROFILE_MAX_COMMANDS ; i++) {
+        count += seq_profile[i].count;
+        time += seq_profile[i].time;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    return ((uint16_t)((time * PROFILE_CYCLES_PER_COUNT) / count));
+}
+
+#endif  // SEQ_PROFILE
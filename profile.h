@@ -0,0 +1,45 @@
+//
+// profile.h : sequence interpreter profiler
+//
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// Each dispatch is timed with Timer1, free running from Fosc/4 with a
+// 1:8 prescale, so one count is 8 instruction cycles (0.8uS).  The time
+// for a WAIT includes the wait itself and is not meaningful; a dispatch
+// longer than one Timer1 wrap (52mS) is not measured correctly.
+//
+#define     PROFILE_CYCLES_PER_COUNT     8
+#define     PROFILE_MAX_COMMANDS        24      // opcodes tracked (0 -> 23)
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+typedef struct {
+       uint16_t  count;               // dispatches
+       uint32_t  time;                // Timer1 counts, including dispatch overhead
+} PROFILE_ENTRY;
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern PROFILE_ENTRY   seq_profile[PROFILE_MAX_COMMANDS];
+extern uint16_t        profile_dispatches;      // all commands since Profile_Reset()
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void      Profile_Init(void);
+void      Profile_Reset(void);
+void      Profile_Start(void);
+void      Profile_Stop(uint8_t command);
+uint16_t  Profile_Cycles_Per_Command(void);
+
+#endif //_PROFILE_H
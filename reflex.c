@@ -0,0 +1,77 @@
+//
+// reflex.c : obstacle reflex acting on scanned A/D channels
+//
+// The check runs in the A/D interrupt routine on every raw scanner sample,
+// so the motors are stopped without waiting for the sequence interpreter
+// (which may be sitting in a WAIT).  The reflex only acts while a motor is
+// driving forward so that the sequence can still back away from the
+// obstacle.  A motor is driving forward when its direction pin is forward
+// and its duty is not zero; the pins stay forward after STOP.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// Global variables
+//
+static uint16_t   reflex_threshold[ADC_SCAN_MAX_CHANNELS];    // 0 == not monitored
+static uint8_t    reflex_count[ADC_SCAN_MAX_CHANNELS];
+
+//************************************************************************
+// Reflex_Init : disable monitoring of all scanner slots
+// ===========
+//
+void Reflex_Init(void)
+{
+uint8_t  i;
+
+    for (i=0 ; i < ADC_SCAN_MAX_CHANNELS ; i++) {
+        reflex_threshold[i] = 0;
+        reflex_count[i] = 0;
+    }
+}
+
+//************************************************************************
+// Reflex_Set : set the obstacle threshold for a scanner slot
+// ==========
+//
+// Notes
+//    A threshold of 0 disables the reflex for the slot.  The A/D interrupt
+//    is held off while the 16-bit threshold is written.
+//
+void Reflex_Set(uint8_t slot, uint16_t threshold)
+{
+uint8_t  adie;
+
+    adie = PIE1bits.ADIE;
+    PIE1bits.ADIE = 0;
+    reflex_threshold[slot] = threshold;
+    reflex_count[slot] = 0;
+    PIE1bits.ADIE = adie;
+}
+
+//************************************************************************
+// Reflex_Check : compare a raw sample against its threshold
+// ============
+//
+// Description
+//    Called at interrupt level.  REFLEX_HITS consecutive samples over the
+//    threshold stop both motors and raise EVENT_OBSTACLE.
+//
+void Reflex_Check(uint8_t slot, uint16_t sample)
+{
+    if ((reflex_threshold[slot] == 0) || (sample < reflex_threshold[slot])) {
+        reflex_count[slot] = 0;
+        return;
+    }
+    if (++reflex_count[slot] < REFLEX_HITS) {
+        return;
+    }
+    reflex_count[slot] = 0;
+    if (((RIGHT_MOTOR_DIR == SET_FORWARD) && (RIGHT_DUTY_REG != 0)) ||
+        ((LEFT_MOTOR_DIR == SET_FORWARD) && (LEFT_DUTY_REG != 0))) {
+        MOTORS_OFF();
+        seq_events |= EVENT_OBSTACLE;
+    }
+}
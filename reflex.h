@@ -0,0 +1,35 @@
+//
+// reflex.h : obstacle reflex acting on scanned A/D channels
+//
+#ifndef _REFLEX_H
+#define _REFLEX_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// IR distance sensors give a higher voltage as an object gets closer.
+// Thresholds are raw 10-bit A/D counts (~1.3V == ~20cm for a GP2D12).
+//
+#define     OBSTACLE_THRESHOLD    266
+#define     REFLEX_HITS             2     // consecutive samples over threshold
+//
+// Worst case sensor to motor stop latency, with NOS_SCAN_SLOTS (3) scanner
+// slots converted one per 200uS PWM period :-
+//
+//      REFLEX_HITS * 3 * 200uS     sample interval of the channel
+//    +              50uS           motor current + scan conversions
+//    +              10uS           interrupt entry and reflex check
+//    =            1260uS
+//
+#define     REFLEX_LATENCY_US    1260
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void  Reflex_Init(void);
+void  Reflex_Set(uint8_t slot, uint16_t threshold);
+void  Reflex_Check(uint8_t slot, uint16_t sample);
+
+#endif //_REFLEX_H
@@ -0,0 +1,317 @@
+//
+// runlog.c : compressed run log in RAM and data EEPROM
+//
+// Built in when RUN_LOG is defined in defines.h.  The interpreter, the
+// I2C driver and the wait loop add records (see runlog.h for the
+// format) to a RAM ring.  Building a record is a tick subtraction and a
+// few byte stores; nothing here waits.  The ring is copied to data
+// EEPROM one byte per call of Run_Log_Flush() from the wait loop, since
+// each EEPROM byte takes about 4mS, and the rest is written by
+// Run_Log_Sync() once the sequence has finished.
+//
+// Records that do not fit in the ring, or that arrive after the EEPROM
+// area is full, are dropped and counted.  The log is restarted at every
+// boot, so download it (see Run_Log_Command) before the next run.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+#ifdef RUN_LOG
+
+//************************************************************************
+// Module variables
+//
+static uint8_t    log_ring[LOG_RING_SIZE];
+static uint8_t    log_head;              // next byte to be stored
+static uint8_t    log_tail;              // next byte to go to EEPROM
+static uint16_t   log_tick;              // tick of the last record stored
+static uint16_t   log_now;               // tick of the record being built
+static uint16_t   log_length;            // bytes written to EEPROM
+static uint8_t    log_lost;
+static uint16_t   log_adc[NOS_SCAN_SLOTS];   // last sensor snapshot
+static uint16_t   log_sensor_tick;
+static uint8_t    log_events;
+static uint8_t    log_line_cmd;          // command of the last LOG_LINE record
+static uint16_t   log_line_tick;         // tick of the last LOG_LINE record
+
+//************************************************************************
+// log_varint : append an unsigned varint to a record
+// ==========
+//
+static uint8_t *log_varint(uint8_t *pt, uint16_t value)
+{
+    while (value >= 0x80) {
+        *pt++ = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    *pt++ = (uint8_t)value;
+    return pt;
+}
+
+//************************************************************************
+// log_zigzag : append a signed varint to a record
+// ==========
+//
+static uint8_t *log_zigzag(uint8_t *pt, int value)
+{
+    if (value < 0) {
+        return log_varint(pt, ((~(uint16_t)value) << 1) | 1);
+    }
+    return log_varint(pt, (uint16_t)value << 1);
+}
+
+//************************************************************************
+// log_header : start a record
+// ==========
+//
+static uint8_t *log_header(uint8_t *pt, uint8_t type)
+{
+uint16_t   delta;
+
+    log_now = Tick_Get();
+    delta = log_now - log_tick;
+    if (delta < LOG_DELTA_ESCAPE) {
+        *pt++ = (type << 5) | (uint8_t)delta;
+        return pt;
+    }
+    *pt++ = (type << 5) | LOG_DELTA_ESCAPE;
+    return log_varint(pt, delta - LOG_DELTA_ESCAPE);
+}
+
+//************************************************************************
+// log_put : store a complete record in the ring
+// =======
+//
+// Description
+//    Returns 1 if the record was stored, 0 if it was dropped.
+//
+// Notes
+//    A record is stored whole or not at all.  The time of a dropped
+//    record is not consumed, so the next delta still counts from the last
+//    record stored.
+//
+static uint8_t log_put(const uint8_t *record, uint8_t count)
+{
+uint8_t   i, head;
+
+    if (count > ((log_tail - log_head - 1) & LOG_RING_MASK)) {
+        if (log_lost != 0xFF) {
+            log_lost++;
+        }
+        return 0;
+    }
+    head = log_head;
+    for (i=0 ; i < count ; i++) {
+        log_ring[head] = record[i];
+        head = (head + 1) & LOG_RING_MASK;
+    }
+    log_head = head;
+    log_tick = log_now;
+    return 1;
+}
+
+//************************************************************************
+// log_write_header : update the EEPROM header
+// ================
+//
+static void log_write_header(void)
+{
+    EEPROM_Write(LOG_EE_BASE + 1, (uint8_t)log_length);
+    EEPROM_Write(LOG_EE_BASE + 2, (uint8_t)(log_length >> 8));
+    EEPROM_Write(LOG_EE_BASE + 3, log_lost);
+}
+
+//************************************************************************
+// Run_Log_Init : start a new log
+// ============
+//
+// Notes
+//    Called after Tick_Init() and before the first I2C transfer.
+//
+void Run_Log_Init(void)
+{
+uint8_t   i, record[3];
+
+    log_head = 0;
+    log_tail = 0;
+    log_length = 0;
+    log_lost = 0;
+    log_events = seq_events;
+    for (i=0 ; i < NOS_SCAN_SLOTS ; i++) {
+        log_adc[i] = 0;
+    }
+    EEPROM_Write(LOG_EE_BASE, LOG_EE_MAGIC);
+    log_write_header();
+
+    log_tick = Tick_Get();
+    log_now = log_tick;
+    log_sensor_tick = log_tick;
+    log_line_cmd = 0xFF;
+    log_line_tick = log_tick - LOG_LINE_TICKS;
+    record[0] = (LOG_START << 5);
+    record[1] = (uint8_t)log_tick;
+    record[2] = (uint8_t)(log_tick >> 8);
+    log_put(record, 3);
+}
+
+//************************************************************************
+// Run_Log_Line : record a command dispatch
+// ============
+//
+// Notes
+//    Called for every dispatch, but only a change of command is logged,
+//    and no more than one every LOG_LINE_TICKS mS, so a tight loop does
+//    not fill the ring and push out the speed and event records.  The
+//    command and time are only taken once the record is stored, so a
+//    dispatch dropped on a full ring is logged when there is room.
+//
+void Run_Log_Line(uint8_t line, uint8_t cmd)
+{
+uint8_t   record[LOG_MAX_RECORD], *pt;
+
+    if ((cmd == log_line_cmd) || (Tick_Elapsed(log_line_tick) < LOG_LINE_TICKS)) {
+        return;
+    }
+    pt = log_header(record, LOG_LINE);
+    *pt++ = line;
+    *pt++ = cmd;
+    if (log_put(record, pt - record)) {
+        log_line_cmd = cmd;
+        log_line_tick = log_now;
+    }
+}
+
+//************************************************************************
+// Run_Log_Speed : record new motor setpoints
+// =============
+//
+void Run_Log_Speed(int right, int left)
+{
+uint8_t   record[LOG_MAX_RECORD], *pt;
+
+    pt = log_header(record, LOG_SPEED);
+    pt = log_zigzag(pt, right);
+    pt = log_zigzag(pt, left);
+    log_put(record, pt - record);
+}
+
+//************************************************************************
+// Run_Log_I2C : record a failed I2C transfer
+// ===========
+//
+void Run_Log_I2C(uint8_t address, uint8_t status)
+{
+uint8_t   record[LOG_MAX_RECORD], *pt;
+
+    pt = log_header(record, LOG_I2C);
+    *pt++ = address;
+    *pt++ = status;
+    log_put(record, pt - record);
+}
+
+//************************************************************************
+// Run_Log_Poll : record event changes and periodic sensor snapshots
+// ============
+//
+// Notes
+//    Sensor values are logged as the change since the last snapshot,
+//    so a steady reading costs one byte per channel.
+//
+void Run_Log_Poll(void)
+{
+uint8_t    i, events, record[LOG_MAX_RECORD], *pt;
+uint16_t   value;
+
+    events = seq_events;
+    if (events != log_events) {
+        pt = log_header(record, LOG_EVENTS);
+        *pt++ = events;
+        log_put(record, pt - record);
+        log_events = events;
+    }
+    if (Tick_Elapsed(log_sensor_tick) >= LOG_SENSOR_TICKS) {
+        pt = log_header(record, LOG_SENSORS);
+        log_sensor_tick = log_now;
+        for (i=0 ; i < NOS_SCAN_SLOTS ; i++) {
+            value = ADC_Scan_Value(i);
+            pt = log_zigzag(pt, (int)(value - log_adc[i]));
+            log_adc[i] = value;
+        }
+        log_put(record, pt - record);
+    }
+}
+
+//************************************************************************
+// Run_Log_Flush : copy one byte of the ring to EEPROM
+// =============
+//
+void Run_Log_Flush(void)
+{
+    if (log_tail == log_head) {
+        return;
+    }
+    if (log_length >= LOG_EE_DATA_SIZE) {
+        log_tail = log_head;                // EEPROM full : discard
+        if (log_lost != 0xFF) {
+            log_lost++;
+        }
+        return;
+    }
+    EEPROM_Write(LOG_EE_BASE + LOG_EE_HEADER + log_length, log_ring[log_tail]);
+    log_tail = (log_tail + 1) & LOG_RING_MASK;
+    log_length++;
+    if ((log_length & (LOG_EE_PAGE - 1)) == 0) {
+        log_write_header();
+    }
+}
+
+//************************************************************************
+// Run_Log_Sync : copy all of the ring to EEPROM and update the header
+// ============
+//
+void Run_Log_Sync(void)
+{
+    while (log_tail != log_head) {
+        Run_Log_Flush();
+    }
+    log_write_header();
+}
+
+#ifdef SEQ_LOADER
+//************************************************************************
+// Run_Log_Command : answer a log download request
+// ===============
+//
+// Notes
+//    Called by the sequence loader for frames that are not its own.
+//    The log is synchronised first, so the download includes records
+//    still in the ring.
+//
+void Run_Log_Command(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+uint8_t    i, count, reply[5 + LOG_READ_MAX];
+uint16_t   offset;
+
+    if ((type != LOG_READ) || (length != 2)) {
+        return;
+    }
+    Run_Log_Sync();
+    offset = payload[0] | ((uint16_t)payload[1] << 8);
+    count = 0;
+    if (offset < log_length) {
+        count = ((log_length - offset) > LOG_READ_MAX) ? LOG_READ_MAX : (uint8_t)(log_length - offset);
+    }
+    reply[0] = payload[0];
+    reply[1] = payload[1];
+    reply[2] = (uint8_t)log_length;
+    reply[3] = (uint8_t)(log_length >> 8);
+    reply[4] = log_lost;
+    for (i=0 ; i < count ; i++) {
+        reply[5 + i] = EEPROM_Read(LOG_EE_BASE + LOG_EE_HEADER + offset + i);
+    }
+    Telemetry_Send(TELEM_LOG, reply, 5 + count);
+}
+#endif  // SEQ_LOADER
+
+#endif  // RUN_LOG
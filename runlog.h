@@ -0,0 +1,78 @@
+//
+// runlog.h : compressed run log in RAM and data EEPROM
+//
+#ifndef _RUNLOG_H
+#define _RUNLOG_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// Record :  header [delta] payload
+//
+// The header byte is (type << 5) | delta, where delta is the number of
+// ticks since the previous record.  A delta of LOG_DELTA_ESCAPE or more
+// is sent as LOG_DELTA_ESCAPE followed by (delta - LOG_DELTA_ESCAPE) as a
+// varint : 7 bits per byte, least significant first, bit 7 set on all but
+// the last byte.  Signed values are zigzag coded (0,-1,1,-2 -> 0,1,2,3)
+// before the varint.  Erased EEPROM (0xFF) reads as type 7 : end of log.
+//
+#define     LOG_START             0       // payload : tick (2 bytes)
+#define     LOG_LINE              1       // line, command : on a change of command (see LOG_LINE_TICKS)
+#define     LOG_SPEED             2       // right, left duty (zigzag varints, - = reverse)
+#define     LOG_SENSORS           3       // change in each ADC scan value (zigzag varints)
+#define     LOG_EVENTS            4       // seq_events when it changes
+#define     LOG_I2C               5       // address, status of a failed transfer
+
+#define     LOG_DELTA_ESCAPE      31
+#define     LOG_MAX_RECORD        (1 + 3 + (3 * NOS_SCAN_SLOTS))
+
+#define     LOG_RING_SIZE        128      // power of 2
+#define     LOG_RING_MASK        (LOG_RING_SIZE - 1)
+#define     LOG_SENSOR_TICKS     250      // sensor snapshot every 250mS during WAITs
+#define     LOG_LINE_TICKS        20      // at most one LOG_LINE record per 20mS
+//
+// Data EEPROM layout : between the sequence program store and the
+// benchmark baselines (see bench.h)
+//
+//    LOG_EE_BASE + 0    LOG_EE_MAGIC
+//                + 1    bytes of log (low byte first)
+//                + 3    records lost (ring or EEPROM full), saturates at 255
+//                + 4    log
+//
+// The length is rewritten every LOG_EE_PAGE bytes and when the log is
+// synchronised, so a power failure loses at most one page.
+//
+#define     LOG_EE_BASE          (SEQ_EE_BASE + SEQ_EE_SIZE)
+#define     LOG_EE_SIZE          (BENCH_EE_BASE - LOG_EE_BASE)
+#define     LOG_EE_MAGIC         0xA7
+#define     LOG_EE_HEADER        4
+#define     LOG_EE_DATA_SIZE     (LOG_EE_SIZE - LOG_EE_HEADER)
+#define     LOG_EE_PAGE          16
+//
+// Download (with SEQ_LOADER) : a LOG_READ frame [offset_lo][offset_hi] is
+// answered with a TELEM_LOG record
+//
+//    [offset_lo][offset_hi][length_lo][length_hi][lost][up to LOG_READ_MAX bytes]
+//
+#define     LOG_READ             0x84
+#define     LOG_READ_MAX         32
+
+#if defined(RUN_LOG) && !defined(__18F4585)
+#error "RUN_LOG needs the spare data EEPROM of the 18F4585"
+#endif
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void     Run_Log_Init(void);
+void     Run_Log_Line(uint8_t line, uint8_t cmd);
+void     Run_Log_Speed(int right, int left);
+void     Run_Log_I2C(uint8_t address, uint8_t status);
+void     Run_Log_Poll(void);
+void     Run_Log_Flush(void);
+void     Run_Log_Sync(void);
+void     Run_Log_Command(uint8_t type, const uint8_t *payload, uint8_t length);
+
+#endif //_RUNLOG_H
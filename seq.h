@@ -0,0 +1,77 @@
+//
+// seq.h : sequence interpreter types and state
+//
+// The command language is described at the top of buggy2b.c.
+//
+#ifndef _SEQ_H
+#define _SEQ_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+#define     NOS_VARS        10        // user variables V0 to V9
+#define     SEQ_CALL_DEPTH   4        // nested CALLs
+#define     SEQ_LOOP_DEPTH   4        // nested REPEAT blocks
+#define     SEQ_RAND_SEED  143        // LOAD_RAND seed set by Seq_Init()
+
+typedef enum {SETSPEED, FINISH, START, STOP, WAIT, JUMP, SETVAR, LOAD_RAND,
+              DECSKIP, CALC, TESTSKIP, EVENTSKIP, CALL, RETURN, REPEAT, END,
+              DJNZ, SETGO,                        // superinstructions (see seq_load.c)
+              PRINT, SHOWVAR, SHOWSPEED,
+              NOS_COMMANDS                        // number of opcodes
+} COMMAND;
+typedef enum {FULL_SPEED=100, HALF_SPEED=50} SPEED;  // % value
+typedef enum {RUNNING, STOPPED} SEQ_STATE;
+typedef enum {FORWARD, BACKWARD} DIRECTION;
+enum {V0, V1, V2, V3, V4, V5, V6, V7, V8, V9};
+enum {IMMEDIATE, REGISTER};
+enum {ADD};
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+// One line of a sequence program.  The layout (7 bytes, no padding) is
+// also the format of a program held in data EEPROM.
+//
+typedef struct {
+       uint8_t    cmd;                            // COMMAND
+       int        param1, param2, param3;
+} SEQ_ENTRY;
+
+// Everything a running sequence changes is held in one context, including
+// the LOAD_RAND generator, so more than one context can be kept (e.g. to
+// save and restore a sequence, or for a test harness).  The program cache
+// and 'seq_events' are not part of it : they belong to the vehicle and
+// are shared by every context.
+//
+typedef struct {
+       int        vars[NOS_VARS];                 // user variables : vars[0] to vars[9]
+       int        right_speed, left_speed;        // PWM duty from the last SETSPEED
+       uint8_t    left_direction, right_direction;
+       int        left_offset, right_offset;      // per-motor calibration
+       uint8_t    seq_counter;                    // line being executed
+       uint8_t    call_stack[SEQ_CALL_DEPTH];     // CALL return lines
+       uint8_t    call_depth;
+       uint8_t    loop_start[SEQ_LOOP_DEPTH];     // first line of each open REPEAT
+       int        loop_count[SEQ_LOOP_DEPTH];     // passes still to run
+       uint8_t    loop_depth;
+       uint16_t   rand_seed;                      // LOAD_RAND generator state
+       SEQ_STATE  state;
+} SEQ_CONTEXT;
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern SEQ_CONTEXT   seq;                         // the vehicle's sequence
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void  Seq_Init(SEQ_CONTEXT *ctx);
+void  exec_seq(SEQ_CONTEXT *ctx, uint8_t seq_start_no);
+
+#endif //_SEQ_H
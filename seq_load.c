@@ -0,0 +1,298 @@
+//
+// seq_load.c : sequence program cache, EEPROM store and serial loader
+//
+// At boot Seq_Load_Program() copies the sequence program into the RAM
+// cache 'seq_program[]' that exec_seq() runs from.  The program comes
+// from data EEPROM if a valid one has been loaded there (see seq_load.h
+// for the layout), otherwise from the built-in table in program memory.
+//
+// While filling the cache, pairs of lines that always run together are
+// rewritten as one superinstruction : DECSKIP var + JUMP line becomes
+// DJNZ var,line and SETSPEED + START becomes SETGO.  The second line of
+// each pair is kept, so no line numbers move and a JUMP to it still
+// does what it did.
+//
+// The serial loader is built in when SEQ_LOADER is defined.  It uses the
+// telemetry framing in both directions and is polled from seq_wait() as
+// well as the idle loop in main(), so a program that loops forever (with
+// a WAIT in the loop) can still be replaced : the running program is
+// abandoned as soon as a load begins, and main() runs the new one once
+// it has been committed.  Every EEPROM write is waited for (about 4mS a
+// byte), which is why each frame is acknowledged before the host sends
+// the next.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// Global variables
+//
+SEQ_ENTRY   seq_program[SEQ_MAX_LINES];
+uint8_t     seq_program_lines;
+uint8_t     seq_program_source;
+
+#ifdef SEQ_LOADER
+//************************************************************************
+// Module variables
+//
+static uint8_t   load_payload[TELEM_MAX_PAYLOAD];
+static uint8_t   load_lines;            // lines announced by LOAD_BEGIN, 0 if idle
+#endif
+
+//************************************************************************
+// seq_check_line : check that a line can be run safely
+// ==============
+//
+// Description
+//    Returns 1 if the opcode is known, every variable index is below
+//    NOS_VARS, every line number is below 'lines' and a LOAD_RAND range
+//    holds 1 to 32767 values; otherwise 0.  exec_seq() takes the random
+//    number modulo the number of values as an int, so a range outside
+//    that would divide by zero or give a negative count.
+//
+static uint8_t seq_check_line(const SEQ_ENTRY *line, uint8_t lines)
+{
+    switch (line->cmd) {
+        case SETVAR :
+        case DECSKIP :
+        case SHOWVAR :
+            return ((uint16_t)line->param1 < NOS_VARS);
+        case LOAD_RAND :
+            return (((uint16_t)line->param1 < NOS_VARS) && (line->param3 >= line->param2) &&
+                    (((long)line->param3 - line->param2) < 32767));
+        case CALC :
+            return ((uint16_t)line->param2 < NOS_VARS);
+        case SETSPEED :
+        case SETGO :
+            return ((line->param1 != REGISTER) ||
+                    (((uint16_t)line->param2 < NOS_VARS) && ((uint16_t)line->param3 < NOS_VARS)));
+        case REPEAT :
+            return ((line->param1 != REGISTER) || ((uint16_t)line->param2 < NOS_VARS));
+        case JUMP :
+        case CALL :
+            return ((uint16_t)line->param1 < lines);
+        case DJNZ :
+            return (((uint16_t)line->param1 < NOS_VARS) && ((uint16_t)line->param2 < lines));
+        default :
+            return (line->cmd < NOS_COMMANDS);
+    }
+}
+
+//************************************************************************
+// seq_fuse : rewrite pairs of lines in the cache as superinstructions
+// ========
+//
+static void seq_fuse(void)
+{
+uint8_t   i;
+
+    for (i=0 ; (i + 1) < seq_program_lines ; i++) {
+        if ((seq_program[i].cmd == DECSKIP) && (seq_program[i + 1].cmd == JUMP)) {
+            seq_program[i].cmd = DJNZ;
+            seq_program[i].param2 = seq_program[i + 1].param1;
+        }
+        else if ((seq_program[i].cmd == SETSPEED) && (seq_program[i + 1].cmd == START)) {
+            seq_program[i].cmd = SETGO;
+        }
+    }
+}
+
+//************************************************************************
+// Seq_Load_Program : fill the program cache
+// ================
+//
+// Description
+//    Uses the program in data EEPROM if its magic byte, length and CRC
+//    are good and every line passes seq_check_line(), otherwise copies
+//    the first 'lines' lines of 'fallback'.
+//    Returns SEQ_FROM_EEPROM or SEQ_FROM_ROM.  Superinstructions are
+//    fused in the cached copy only.
+//
+// Notes
+//    A built-in table longer than SEQ_MAX_LINES is truncated.
+//
+uint8_t Seq_Load_Program(const rom SEQ_ENTRY *fallback, uint8_t lines)
+{
+uint8_t            n, *pt;
+uint16_t           i, count, address, crc;
+
+    n = EEPROM_Read(SEQ_EE_BASE + 1);
+    if ((EEPROM_Read(SEQ_EE_BASE) == SEQ_EE_MAGIC) &&
+        (n != 0) && (n <= SEQ_MAX_LINES) && (n <= SEQ_EE_MAX_LINES)) {
+        pt = (uint8_t *)seq_program;
+        address = SEQ_EE_BASE + SEQ_EE_HEADER;
+        count = n * SEQ_ENTRY_SIZE;
+        crc = CRC16_INIT;
+        for (i=0 ; i < count ; i++) {
+            *pt = EEPROM_Read(address++);
+            crc = crc16_byte(crc, *pt++);
+        }
+        for (i=0 ; i < n ; i++) {
+            if (!seq_check_line(&seq_program[i], n)) {
+                break;
+            }
+        }
+        if ((i == n) &&
+            (EEPROM_Read(SEQ_EE_BASE + 2) == (uint8_t)crc) &&
+            (EEPROM_Read(SEQ_EE_BASE + 3) == (uint8_t)(crc >> 8))) {
+            seq_program_lines = n;
+            seq_program_source = SEQ_FROM_EEPROM;
+            seq_fuse();
+            return SEQ_FROM_EEPROM;
+        }
+    }
+
+    Seq_Load_Rom(fallback, lines);
+    return SEQ_FROM_ROM;
+}
+
+//************************************************************************
+// Seq_Load_Rom : fill the program cache from program memory
+// ============
+//
+// Description
+//    Copies the first 'lines' lines of 'program' and fuses the
+//    superinstructions.  Used for the built-in table and by the sequence
+//    benchmark, which loads each reference program on its own.
+//
+// Notes
+//    A table longer than SEQ_MAX_LINES is truncated.
+//
+void Seq_Load_Rom(const rom SEQ_ENTRY *program, uint8_t lines)
+{
+uint8_t            *pt;
+const rom uint8_t  *rom_pt;
+uint16_t           i, count;
+
+    if (lines > SEQ_MAX_LINES) {
+        lines = SEQ_MAX_LINES;
+    }
+    pt = (uint8_t *)seq_program;
+    rom_pt = (const rom uint8_t *)program;
+    count = lines * SEQ_ENTRY_SIZE;
+    for (i=0 ; i < count ; i++) {
+        *pt++ = *rom_pt++;
+    }
+    seq_program_lines = lines;
+    seq_program_source = SEQ_FROM_ROM;
+    seq_fuse();
+}
+
+#ifdef SEQ_LOADER
+//************************************************************************
+// load_ack : reply to a loader frame
+// ========
+//
+static void load_ack(uint8_t type, uint8_t status)
+{
+uint8_t   reply[2];
+
+    reply[0] = type;
+    reply[1] = status;
+    Telemetry_Send(TELEM_LOAD_ACK, reply, 2);
+}
+
+//************************************************************************
+// Seq_Loader_Init : start listening for loader frames
+// ===============
+//
+// Notes
+//    Called after Telemetry_Init(), which opens the serial port.
+//
+void Seq_Loader_Init(void)
+{
+    load_lines = 0;
+    UART_RX_Enable();
+}
+
+//************************************************************************
+// Seq_Loader_Poll : handle any loader frames that have arrived
+// ===============
+//
+// Description
+//    Returns LOADER_DONE when LOAD_END has committed a new program to
+//    EEPROM, so the caller can reload the cache and run it, LOADER_BUSY
+//    while a load is in progress, otherwise LOADER_IDLE.
+//
+// Notes
+//    LOAD_BEGIN clears the magic byte first, so until LOAD_END succeeds
+//    the buggy boots into the built-in program.  LOAD_END reads the
+//    lines back from EEPROM to check the CRC, which also verifies the
+//    writes, and refuses a program with a line that fails
+//    seq_check_line().
+//
+uint8_t Seq_Loader_Poll(void)
+{
+uint8_t    type, length, n, status, valid;
+uint8_t    *pt;
+uint16_t   i, address, crc;
+SEQ_ENTRY  line;
+
+    while (Telemetry_Receive(&type, load_payload, &length)) {
+        status = LOAD_ERROR;
+        switch (type) {
+            case LOAD_BEGIN :
+                load_lines = 0;
+                if ((length == 1) && (load_payload[0] != 0) &&
+                    (load_payload[0] <= SEQ_MAX_LINES) && (load_payload[0] <= SEQ_EE_MAX_LINES)) {
+                    EEPROM_Write(SEQ_EE_BASE, 0xFF);
+                    load_lines = load_payload[0];
+                    status = LOAD_OK;
+                }
+                break;
+            case LOAD_DATA :
+                if ((load_lines == 0) || (length < (1 + SEQ_ENTRY_SIZE))) {
+                    break;
+                }
+                n = (length - 1) / SEQ_ENTRY_SIZE;
+                if (((n * SEQ_ENTRY_SIZE) != (length - 1)) ||
+                    ((load_payload[0] + n) > load_lines)) {
+                    break;
+                }
+                address = SEQ_EE_BASE + SEQ_EE_HEADER + (load_payload[0] * SEQ_ENTRY_SIZE);
+                for (i=1 ; i < length ; i++) {
+                    EEPROM_Write(address++, load_payload[i]);
+                }
+                status = LOAD_OK;
+                break;
+            case LOAD_END :
+                if ((load_lines == 0) || (length != 2)) {
+                    break;
+                }
+                address = SEQ_EE_BASE + SEQ_EE_HEADER;
+                crc = CRC16_INIT;
+                valid = 1;
+                for (n=0 ; n < load_lines ; n++) {
+                    pt = (uint8_t *)&line;
+                    for (i=0 ; i < SEQ_ENTRY_SIZE ; i++) {
+                        *pt = EEPROM_Read(address++);
+                        crc = crc16_byte(crc, *pt++);
+                    }
+                    if (!seq_check_line(&line, load_lines)) {
+                        valid = 0;
+                    }
+                }
+                if (valid &&
+                    (load_payload[0] == (uint8_t)crc) && (load_payload[1] == (uint8_t)(crc >> 8))) {
+                    EEPROM_Write(SEQ_EE_BASE + 1, load_lines);
+                    EEPROM_Write(SEQ_EE_BASE + 2, load_payload[0]);
+                    EEPROM_Write(SEQ_EE_BASE + 3, load_payload[1]);
+                    EEPROM_Write(SEQ_EE_BASE, SEQ_EE_MAGIC);
+                    status = LOAD_OK;
+                }
+                load_lines = 0;
+                load_ack(type, status);
+                return ((status == LOAD_OK) ? LOADER_DONE : LOADER_IDLE);
+            default :
+#ifdef RUN_LOG
+                Run_Log_Command(type, load_payload, length);
+#endif
+                continue;                   // not a loader frame
+        }
+        load_ack(type, status);
+    }
+    return ((load_lines != 0) ? LOADER_BUSY : LOADER_IDLE);
+}
+
+#endif  // SEQ_LOADER
@@ -0,0 +1,75 @@
+//
+// seq_load.h : sequence program cache, EEPROM store and serial loader
+//
+#ifndef _SEQ_LOAD_H
+#define _SEQ_LOAD_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+#define     SEQ_MAX_LINES        36       // RAM cache : 252 bytes, fits one 256 byte bank
+#define     SEQ_ENTRY_SIZE       (sizeof(SEQ_ENTRY))
+
+#define     SEQ_FROM_ROM          0       // values of 'seq_program_source'
+#define     SEQ_FROM_EEPROM       1
+//
+// Data EEPROM layout of a loaded program.  The magic byte is written
+// last, so a load that is interrupted leaves no valid program.
+//
+//    SEQ_EE_BASE + 0    SEQ_EE_MAGIC
+//                + 1    number of lines
+//                + 2    CRC-16 of the lines (low byte first)
+//                + 4    lines, SEQ_ENTRY_SIZE bytes each
+//
+#define     SEQ_EE_BASE          0x000
+#if defined(__18F4585)
+#define     SEQ_EE_SIZE          0x200    // upper half is free for other uses
+#else
+#define     SEQ_EE_SIZE          (EEPROM_SIZE - BENCH_EE_SIZE)
+#endif
+#define     SEQ_EE_MAGIC         0x5A
+#define     SEQ_EE_HEADER        4
+#define     SEQ_EE_MAX_LINES     ((SEQ_EE_SIZE - SEQ_EE_HEADER) / 7)
+//
+// Serial loader frames (host to buggy, telemetry framing, see telemetry.h)
+//
+//    LOAD_BEGIN  [lines]                      erase the stored program
+//    LOAD_DATA   [first line][lines * 7]      store lines
+//    LOAD_END    [crc_lo][crc_hi]             check and commit
+//
+// Each is answered with a TELEM_LOAD_ACK record [frame type][status].
+//
+#define     LOAD_BEGIN           0x81
+#define     LOAD_DATA            0x82
+#define     LOAD_END             0x83
+
+#define     LOAD_OK              0
+#define     LOAD_ERROR           1
+
+#define     LOADER_IDLE          0        // values returned by Seq_Loader_Poll()
+#define     LOADER_BUSY          1        // a load has begun and not yet ended
+#define     LOADER_DONE          2        // a new program has been committed
+
+#if defined(SEQ_LOADER) && !defined(TELEMETRY)
+#error "SEQ_LOADER needs TELEMETRY"
+#endif
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern SEQ_ENTRY   seq_program[SEQ_MAX_LINES];
+extern uint8_t     seq_program_lines;
+extern uint8_t     seq_program_source;
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+uint8_t  Seq_Load_Program(const rom SEQ_ENTRY *fallback, uint8_t lines);
+void     Seq_Load_Rom(const rom SEQ_ENTRY *program, uint8_t lines);
+void     Seq_Loader_Init(void);
+uint8_t  Seq_Loader_Poll(void);
+
+#endif //_SEQ_LOAD_H
@@ -0,0 +1,190 @@
+//
+// telemetry.c : periodic binary status records on the serial port
+//
+// Built in when TELEMETRY is defined in defines.h.  Telemetry_Poll() is
+// called from the foreground loops and sends a TELEM_STATUS record every
+// TELEM_PERIOD_TICKS.  Sending costs the copy of the fields, the CRC and
+// the copy into the UART buffer; the bytes go out under interrupt.  If
+// the buffer is full the record is dropped, never waited for.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+#ifdef TELEMETRY
+
+//************************************************************************
+// Module variables
+//
+static uint8_t               frame[TELEM_HEADER_SIZE + TELEM_MAX_PAYLOAD + TELEM_CRC_SIZE];
+static TELEM_STATUS_RECORD   status;
+static uint16_t              telem_tick;         // tick of the last record
+static uint8_t               rx_frame[TELEM_HEADER_SIZE + TELEM_MAX_PAYLOAD + TELEM_CRC_SIZE];
+static uint8_t               rx_count;           // bytes of 'rx_frame' received
+
+//************************************************************************
+// Telemetry_Init : open the serial port and start the record timer
+// ==============
+//
+void Telemetry_Init(void)
+{
+    UART_Open();
+    telem_tick = Tick_Get();
+    rx_count = 0;
+}
+
+//************************************************************************
+// Telemetry_Send : frame a record and queue it for transmission
+// ==============
+//
+// Description
+//    Returns 1 if the frame was queued, 0 if it was dropped (payload too
+//    long or no room in the UART buffer).
+//
+uint8_t Telemetry_Send(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+uint8_t   i, *pt;
+uint16_t  crc;
+
+    if (length > TELEM_MAX_PAYLOAD) {
+        return 0;
+    }
+    frame[0] = TELEM_SYNC_1;
+    frame[1] = TELEM_SYNC_2;
+    frame[2] = type;
+    frame[3] = length;
+    pt = &frame[TELEM_HEADER_SIZE];
+    for (i=0 ; i < length ; i++) {
+        *pt++ = payload[i];
+    }
+    crc = crc16_update(CRC16_INIT, &frame[2], length + 2);
+    *pt++ = (uint8_t)crc;
+    *pt = (uint8_t)(crc >> 8);
+    if (UART_Write(frame, TELEM_HEADER_SIZE + length + TELEM_CRC_SIZE) == 0) {
+        return 0;
+    }
+    return 1;
+}
+
+//************************************************************************
+// Telemetry_Receive : assemble a frame from the received bytes
+// =================
+//
+// Description
+//    Reads what is in the UART receive buffer.  Returns 1 when a complete
+//    frame with a good CRC has arrived, with its type, payload (up to
+//    TELEM_MAX_PAYLOAD bytes) and length, or 0 if there is none yet.
+//
+// Notes
+//    A frame with a bad length or CRC is dropped and the receiver hunts
+//    for the next sync pair.  Bytes after a complete frame are left in
+//    the UART buffer for the next call.
+//
+uint8_t Telemetry_Receive(uint8_t *type, uint8_t *payload, uint8_t *length)
+{
+uint8_t   i, data;
+uint16_t  crc;
+
+    while (UART_Read(&data)) {
+        switch (rx_count) {
+            case 0 :
+                if (data == TELEM_SYNC_1) {
+                    rx_count = 1;
+                }
+                break;
+            case 1 :
+                if (data == TELEM_SYNC_2) {
+                    rx_count = 2;
+                } else if (data != TELEM_SYNC_1) {
+                    rx_count = 0;
+                }
+                break;
+            default :
+                rx_frame[rx_count++] = data;
+                if (rx_count < TELEM_HEADER_SIZE) {
+                    break;
+                }
+                if (rx_frame[3] > TELEM_MAX_PAYLOAD) {
+                    rx_count = 0;
+                    break;
+                }
+                if (rx_count < (TELEM_HEADER_SIZE + rx_frame[3] + TELEM_CRC_SIZE)) {
+                    break;
+                }
+                rx_count = 0;
+                crc = crc16_update(CRC16_INIT, &rx_frame[2], rx_frame[3] + 2);
+                if ((rx_frame[TELEM_HEADER_SIZE + rx_frame[3]] != (uint8_t)crc) ||
+                    (rx_frame[TELEM_HEADER_SIZE + rx_frame[3] + 1] != (uint8_t)(crc >> 8))) {
+                    break;
+                }
+                *type = rx_frame[2];
+                *length = rx_frame[3];
+                for (i=0 ; i < rx_frame[3] ; i++) {
+                    payload[i] = rx_frame[TELEM_HEADER_SIZE + i];
+                }
+                return 1;
+        }
+    }
+    return 0;
+}
+
+//************************************************************************
+// Telemetry_Poll : send a status record if one is due
+// ==============
+//
+void Telemetry_Poll(SEQ_CONTEXT *ctx)
+{
+uint8_t    i;
+#ifdef ODOMETRY
+ODO_POSE   pose;
+#endif
+
+    if (Tick_Elapsed(telem_tick) < TELEM_PERIOD_TICKS) {
+        return;
+    }
+    telem_tick = Tick_Get();
+
+    status.tick = telem_tick;
+    status.seq_counter = ctx->seq_counter;
+    status.state = ctx->state;
+    for (i=0 ; i < NOS_VARS ; i++) {
+        status.vars[i] = ctx->vars[i];
+    }
+    status.right_duty = RIGHT_DUTY_REG;
+    status.left_duty = LEFT_DUTY_REG;
+    status.directions = (RIGHT_MOTOR_DIR == SET_REVERSE) ? 0x01 : 0x00;
+    if (LEFT_MOTOR_DIR == SET_REVERSE) {
+        status.directions |= 0x02;
+    }
+    status.events = seq_events;
+    for (i=0 ; i < NOS_SCAN_SLOTS ; i++) {
+        status.adc[i] = ADC_Scan_Value(i);
+    }
+    INTCONbits.GIE = 0;
+    status.motor_current[RIGHT_MOTOR] = motor_current[RIGHT_MOTOR];
+    status.motor_current[LEFT_MOTOR] = motor_current[LEFT_MOTOR];
+    INTCONbits.GIE = 1;
+#ifdef SEQ_PROFILE
+    status.dispatches = profile_dispatches;
+#else
+    status.dispatches = 0;
+#endif
+#ifdef I2C_STATS
+    status.i2c_utilisation = i2c_utilisation;
+#else
+    status.i2c_utilisation = 0;
+#endif
+#ifdef ODOMETRY
+    Odometry_Get(&pose);
+    status.x_mm = pose.x_mm;
+    status.y_mm = pose.y_mm;
+    status.heading = pose.heading;
+#else
+    status.x_mm = 0;
+    status.y_mm = 0;
+    status.heading = 0;
+#endif
+    Telemetry_Send(TELEM_STATUS, (const uint8_t *)&status, sizeof(status));
+}
+
+#endif  // TELEMETRY
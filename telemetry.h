@@ -0,0 +1,61 @@
+//
+// telemetry.h : periodic binary status records on the serial port
+//
+#ifndef _TELEMETRY_H
+#define _TELEMETRY_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// Frame :  SYNC_1 SYNC_2 type length payload[length] crc_lo crc_hi
+//
+// The CRC is CRC-16/CCITT (see misc_lib.c) over type, length and the
+// payload.  Multi-byte fields are little-endian (the PIC byte order).
+// Frames from the host (e.g. the sequence loader) use the same format.
+//
+#define     TELEM_SYNC_1          0xA5
+#define     TELEM_SYNC_2          0x5A
+#define     TELEM_HEADER_SIZE     4
+#define     TELEM_CRC_SIZE        2
+#define     TELEM_MAX_PAYLOAD     64
+
+#define     TELEM_STATUS          0x01      // record types
+#define     TELEM_LOAD_ACK        0x02      // sequence loader reply (see seq_load.h)
+#define     TELEM_LOG             0x03      // run log download (see runlog.h)
+#define     TELEM_PERIOD_TICKS    20        // 50Hz
+
+//************************************************************************
+// Type declarations
+//************************************************************************
+//
+// Fields for options that are not built in are sent as 0.
+//
+typedef struct {
+       uint16_t  tick;                    // system tick when the record was taken
+       uint8_t   seq_counter;
+       uint8_t   state;                   // RUNNING or STOPPED
+       int16_t   vars[NOS_VARS];
+       uint8_t   right_duty;              // duty registers (top 8 bits)
+       uint8_t   left_duty;
+       uint8_t   directions;              // bit 0 right, bit 1 left : 1 = reverse
+       uint8_t   events;                  // seq_events
+       uint16_t  adc[NOS_SCAN_SLOTS];     // scanner values (IR left, IR right, battery)
+       uint16_t  motor_current[2];        // filtered motor currents
+       uint16_t  dispatches;              // SEQ_PROFILE : commands executed
+       uint8_t   i2c_utilisation;         // I2C_STATS : % bus busy
+       int16_t   x_mm;                    // ODOMETRY : estimated pose
+       int16_t   y_mm;
+       uint16_t  heading;
+} TELEM_STATUS_RECORD;
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void     Telemetry_Init(void);
+uint8_t  Telemetry_Send(uint8_t type, const uint8_t *payload, uint8_t length);
+uint8_t  Telemetry_Receive(uint8_t *type, uint8_t *payload, uint8_t *length);
+void     Telemetry_Poll(SEQ_CONTEXT *ctx);
+
+#endif //_TELEMETRY_H
@@ -0,0 +1,107 @@
+//
+// tick.c : 1mS system tick
+//
+// The tick runs at low interrupt priority.  tick_count wraps every 65.5
+// seconds; intervals are measured with Tick_Elapsed() which is correct
+// across the wrap for intervals up to 65535mS.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// Global variables
+//
+volatile uint16_t  tick_count;
+
+//************************************************************************
+// Tick_Init : start the system tick
+// =========
+//
+void Tick_Init(void)
+{
+    tick_count = 0;
+    OpenTimer0(TIMER_INT_OFF & T0_16BIT & T0_SOURCE_INT & T0_PS_1_1);
+    TMR0H = (TICK_RELOAD >> 8);
+    TMR0L = (TICK_RELOAD & 0xFF);
+    INTCON2bits.TMR0IP = 0;           // low priority
+    INTCONbits.TMR0IF = 0;
+    INTCONbits.TMR0IE = 1;
+}
+
+//************************************************************************
+// Tick_ISR : Timer0 overflow interrupt handler
+// ========
+//
+// Notes
+//    Reading TMR0L latches TMR0H, and writing TMR0L transfers the buffered
+//    TMR0H, so the 16-bit timer is read and rewritten as a pair.
+//
+void Tick_ISR(void)
+{
+union {
+    uint8_t   bt[2];
+    uint16_t  wd;
+} tmr;
+
+    tmr.bt[0] = TMR0L;
+    tmr.bt[1] = TMR0H;
+    tmr.wd += TICK_RELOAD;
+    TMR0H = tmr.bt[1];
+    TMR0L = tmr.bt[0];
+    INTCONbits.TMR0IF = 0;
+    tick_count++;
+}
+
+//************************************************************************
+// Tick_Get : read the tick count
+// ========
+//
+// Notes
+//    The low priority interrupts are held off while the two bytes are read
+//    and then put back as they were, so it is safe to call before
+//    Interrupts_Enable().
+//
+uint16_t Tick_Get(void)
+{
+uint16_t  ticks;
+uint8_t   giel;
+
+    giel = INTCONbits.GIEL;
+    INTCONbits.GIEL = 0;
+    ticks = tick_count;
+    INTCONbits.GIEL = giel;
+    return (ticks);
+}
+
+//************************************************************************
+// Tick_Idle : stop the CPU until the next interrupt
+// =========
+//
+// Notes
+//    On the 18F4585 SLEEP with IDLEN set enters IDLE mode : the core
+//    stops but the oscillator, timers, PWM, A/D, MSSP and EUSART keep
+//    running, and any enabled interrupt wakes the core (the tick at the
+//    latest, but the PWM and A/D interrupts every 200uS).  The interrupt
+//    is serviced and execution continues after the SLEEP.  If one is
+//    already pending the SLEEP does nothing.
+//
+//    The 18F452 has no IDLE mode and SLEEP would stop the PWM, so there
+//    this returns at once and the caller simply polls.
+//
+void Tick_Idle(void)
+{
+#if defined(__18F4585)
+    OSCCONbits.IDLEN = 1;
+    Sleep();
+#endif
+}
+
+//************************************************************************
+// Tick_Elapsed : number of ticks since a previous Tick_Get()
+// ============
+//
+uint16_t Tick_Elapsed(uint16_t start)
+{
+    return (Tick_Get() - start);
+}
@@ -0,0 +1,37 @@
+//
+// tick.h : 1mS system tick
+//
+#ifndef _TICK_H
+#define _TICK_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// Timer0 runs in 16-bit mode from Fosc/4 (10MHz) with no prescaler and is
+// reloaded to overflow every 10000 counts.  The reload adds to the count
+// already elapsed, so interrupt latency does not accumulate as drift.
+// TICK_ADJUST covers the instructions lost while the timer is rewritten.
+//
+#define     TICK_COUNTS         10000
+#define     TICK_ADJUST             4
+#define     TICK_RELOAD         ((uint16_t)(0 - TICK_COUNTS + TICK_ADJUST))
+#define     TICKS_PER_SECOND     1000
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern volatile uint16_t  tick_count;
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void      Tick_Init(void);
+void      Tick_ISR(void);
+uint16_t  Tick_Get(void);
+uint16_t  Tick_Elapsed(uint16_t start);
+void      Tick_Idle(void);
+
+#endif //_TICK_H
@@ -0,0 +1,170 @@
+//
+// uart_hw.c : EUSART driver with an interrupt fed transmit buffer
+//
+// The foreground copies complete messages into a ring buffer and the low
+// priority TX interrupt moves them to TXREG one byte at a time, so a
+// message never waits for the line.  A message that does not fit is
+// refused whole rather than truncated.
+//
+// Shared state : 'tx_head' is only written by the foreground and
+// 'tx_tail' only by the interrupt routine, and each is a single byte, so
+// neither side needs to disable interrupts.  The receive buffer is the
+// same with the roles swapped.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+//************************************************************************
+// Module variables
+//
+static uint8_t            tx_buffer[UART_TX_SIZE];
+static volatile uint8_t   tx_head;          // next byte to be written (foreground)
+static volatile uint8_t   tx_tail;          // next byte to be sent (interrupt)
+static uint8_t            rx_buffer[UART_RX_SIZE];
+static volatile uint8_t   rx_head;          // next byte to be stored (interrupt)
+static volatile uint8_t   rx_tail;          // next byte to be read (foreground)
+
+//************************************************************************
+// UART_Open : configure the serial port
+// =========
+//
+// Notes
+//    The receiver is enabled but its interrupt is not.  The transmit
+//    interrupt is enabled by UART_Write() and disabled by the interrupt
+//    routine when the buffer empties.
+//
+void UART_Open(void)
+{
+    tx_head = 0;
+    tx_tail = 0;
+    rx_head = 0;
+    rx_tail = 0;
+
+    TRISCbits.TRISC6 = 1;             // TX and RX pins are driven by the port
+    TRISCbits.TRISC7 = 1;
+#if defined(__18F4585)
+    BAUDCONbits.BRG16 = 1;
+    SPBRGH = (uint8_t)(UART_SPBRG >> 8);
+#endif
+    SPBRG = (uint8_t)UART_SPBRG;
+    TXSTA = 0x24;                     // TXEN, BRGH, async 8-bit
+    RCSTA = 0x90;                     // SPEN, CREN
+    PIE1bits.TXIE = 0;
+    PIE1bits.RCIE = 0;
+}
+
+//************************************************************************
+// UART_Free_Space : number of bytes that can be written now
+// ===============
+//
+uint8_t UART_Free_Space(void)
+{
+    return ((tx_tail - tx_head - 1) & UART_TX_MASK);
+}
+
+//************************************************************************
+// UART_Write : queue a message for transmission
+// ==========
+//
+// Description
+//    Copies 'count' bytes into the transmit buffer.  Returns 'count', or
+//    0 (and queues nothing) if there is not room for all of them.
+//
+uint8_t UART_Write(const uint8_t *data, uint8_t count)
+{
+uint8_t   i, head;
+
+    if (count > UART_Free_Space()) {
+        return 0;
+    }
+    head = tx_head;
+    for (i=0 ; i < count ; i++) {
+        tx_buffer[head] = data[i];
+        head = (head + 1) & UART_TX_MASK;
+    }
+    tx_head = head;
+    PIE1bits.TXIE = 1;
+    return count;
+}
+
+//************************************************************************
+// UART_TX_ISR : transmit interrupt handler
+// ===========
+//
+// Notes
+//    TXIF is cleared by the write to TXREG.  It stays set while TXREG is
+//    empty, so the interrupt is disabled once there is nothing to send.
+//
+void UART_TX_ISR(void)
+{
+uint8_t   tail;
+
+    tail = tx_tail;
+    if (tail != tx_head) {
+        TXREG = tx_buffer[tail];
+        tail = (tail + 1) & UART_TX_MASK;
+        tx_tail = tail;
+    }
+    if (tail == tx_head) {
+        PIE1bits.TXIE = 0;
+    }
+}
+
+//************************************************************************
+// UART_RX_Enable : start buffering received bytes
+// ==============
+//
+void UART_RX_Enable(void)
+{
+uint8_t   dummy;
+
+    dummy = RCREG;                    // discard anything received so far
+    dummy = RCREG;
+    rx_tail = rx_head;
+    PIE1bits.RCIE = 1;
+}
+
+//************************************************************************
+// UART_Read : take a byte from the receive buffer
+// =========
+//
+// Description
+//    Returns 1 and the byte in *data, or 0 if the buffer is empty.
+//
+uint8_t UART_Read(uint8_t *data)
+{
+uint8_t   tail;
+
+    tail = rx_tail;
+    if (tail == rx_head) {
+        return 0;
+    }
+    *data = rx_buffer[tail];
+    rx_tail = (tail + 1) & UART_RX_MASK;
+    return 1;
+}
+
+//************************************************************************
+// UART_RX_ISR : receive interrupt handler
+// ===========
+//
+// Notes
+//    RCIF is cleared by reading RCREG.  An overrun stops the receiver, so
+//    it is restarted by toggling CREN.
+//
+void UART_RX_ISR(void)
+{
+uint8_t   data, head;
+
+    if (RCSTAbits.OERR) {
+        RCSTAbits.CREN = 0;
+        RCSTAbits.CREN = 1;
+    }
+    data = RCREG;
+    head = (rx_head + 1) & UART_RX_MASK;
+    if (head != rx_tail) {
+        rx_buffer[rx_head] = data;
+        rx_head = head;
+    }
+}
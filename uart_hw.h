@@ -0,0 +1,47 @@
+//
+// uart_hw.h : EUSART driver with an interrupt fed transmit buffer
+//
+#ifndef _UART_HW_H
+#define _UART_HW_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// 115200 baud, 8N1.  SPBRG is rounded to the nearest divisor.  On the
+// 18F4585 the EUSART uses the 16-bit baud rate generator (SPBRG =
+// Fosc/(4*baud) - 1 = 86 at 40MHz, 114943 baud, -0.2% error); the 18F452
+// USART uses BRGH = 1 (SPBRG = Fosc/(16*baud) - 1 = 21, 113636 baud,
+// -1.4% error).
+//
+#define     UART_BAUD            115200
+#if defined(__18F4585)
+#define     UART_SPBRG           ((PIC_CLK + 2L * UART_BAUD) / (4L * UART_BAUD) - 1)
+#else
+#define     UART_SPBRG           ((PIC_CLK + 8L * UART_BAUD) / (16L * UART_BAUD) - 1)
+#endif
+//
+// Transmit ring buffer : one slot is kept empty to tell full from empty
+//
+#define     UART_TX_SIZE         128      // power of 2
+#define     UART_TX_MASK         (UART_TX_SIZE - 1)
+//
+// Receive ring buffer : filled by the RX interrupt once UART_RX_Enable()
+// has been called.  Bytes that arrive when it is full are lost.
+//
+#define     UART_RX_SIZE          32      // power of 2
+#define     UART_RX_MASK         (UART_RX_SIZE - 1)
+
+//************************************************************************
+// System functions : prototypes.
+//************************************************************************
+//
+void     UART_Open(void);
+uint8_t  UART_Free_Space(void);
+uint8_t  UART_Write(const uint8_t *data, uint8_t count);
+void     UART_TX_ISR(void);
+void     UART_RX_Enable(void);
+uint8_t  UART_Read(uint8_t *data);
+void     UART_RX_ISR(void);
+
+#endif //_UART_HW_H
@@ -0,0 +1,18 @@
+//
+// ui_strings.c : fixed user interface text held in program memory
+//
+// The strings are output directly from program memory with the '_rom'
+// display routines, so they take no RAM.
+//
+//************************************************************************
+//
+#include      "defines.h"
+
+const rom char * rom ui_strings[NOS_UI_STRINGS] = {
+    "Buggy2b",                // STR_TITLE
+    "Int = ",                 // STR_INT
+    "Bat ",                   // STR_BATTERY
+    "OBSTACLE",               // STR_OBSTACLE
+    "STALL",                  // STR_STALL
+    "LOW BATTERY",            // STR_LOW_BATTERY
+};
@@ -0,0 +1,27 @@
+//
+// ui_strings.h : fixed user interface text held in program memory
+//
+#ifndef _UI_STRINGS_H
+#define _UI_STRINGS_H
+
+//************************************************************************
+// Constant declarations
+//************************************************************************
+//
+// indices into 'ui_strings'
+//
+#define     STR_TITLE            0
+#define     STR_INT              1
+#define     STR_BATTERY          2
+#define     STR_OBSTACLE         3
+#define     STR_STALL            4
+#define     STR_LOW_BATTERY      5
+#define     NOS_UI_STRINGS       6
+
+//************************************************************************
+// Global variables
+//************************************************************************
+//
+extern const rom char * rom ui_strings[NOS_UI_STRINGS];
+
+#endif //_UI_STRINGS_H